@@ -11,10 +11,11 @@
 #include "nvs_flash.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
-#include "lwip/sockets.h"
-#include "lwip/inet.h"
+#include "scada_link.h"
 #include "mqtt_client.h"
 #include "cJSON.h"
+#include "esp_sntp.h"
+#include <sys/time.h>
 #include <dht.h>
 
 /* ================= CONFIG ================= */
@@ -33,6 +34,8 @@
 #define GATEWAY_IP     "x.x.x.x"   // Linux outstation IP
 #define GATEWAY_PORT   9100            // TCP listener port
 #define DEVICE_ID 0
+#define SNTP_SERVER    "pool.ntp.org"
+#define SPILL_FRAMES   128             // readings kept in NVS once the link's RAM queue is full
 
 #define MQTT_URI       "mqtt://x.x.x.x:1885"
 #define MQTT_SUB_TOPIC "sensors/dht/0/cmd"
@@ -136,6 +139,15 @@ static void max_off(void)
     }
 }
 
+/* Reports the switch as applied on MQTT_PUB_TOPIC (retained, QoS 1), so
+ * the gateway sees what the device is really doing, not just what was
+ * asked for on MQTT_SUB_TOPIC. */
+static void publish_status(bool enabled)
+{
+    const char *payload = enabled ? "{\"enable\":true}" : "{\"enable\":false}";
+    esp_mqtt_client_publish(mqtt_client, MQTT_PUB_TOPIC, payload, 0, 1, 1);
+}
+
 static void mqtt_event_handler(void *arg,
                                esp_event_base_t base,
                                int32_t id,
@@ -189,6 +201,7 @@ static void mqtt_event_handler(void *arg,
                         }
                         ESP_LOGI("DHT", "DHT %s (JSON)",
                         dht_enabled ? "ENABLED" : "DISABLED");
+                        publish_status(dht_enabled);
                         cJSON_Delete(root);
                         break;
 
@@ -198,11 +211,13 @@ static void mqtt_event_handler(void *arg,
                 if (strncmp(event->data, "ON", event->data_len) == 0)
                 {
                     dht_enabled = true;
+                    publish_status(dht_enabled);
                     
                 }
                 else if (strncmp(event->data, "OFF", event->data_len) == 0)
                 {
                     dht_enabled = false;
+                    publish_status(dht_enabled);
                 }
                 else 
                 {
@@ -304,6 +319,36 @@ void print_ip(void)
     }
 }
 
+/* Readings carry the device time they were taken at (TS=, ms since epoch)
+ * and a per-boot sequence number (SEQ=): the link queues them through a
+ * gateway outage and resends its last few after a reconnect, and the
+ * gateway keeps the real reading time and drops the copies it already has.
+ * TS=0 until SNTP has synced; the gateway then uses its own clock. */
+static volatile bool time_synced = false;
+static uint32_t frame_seq = 0;
+
+static void time_sync_cb(struct timeval *tv)
+{
+    time_synced = true;
+}
+
+static void sntp_start(void)
+{
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, SNTP_SERVER);
+    sntp_set_time_sync_notification_cb(time_sync_cb);
+    esp_sntp_init();
+}
+
+static uint64_t device_time_ms(void)
+{
+    if (!time_synced) return 0;
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
 static void dht_tcp_task(void *pvParameters)
 {
     int16_t tempRaw = 0;
@@ -324,32 +369,13 @@ static void dht_tcp_task(void *pvParameters)
 
                 ESP_LOGI("DHT", "Temp=%.1f C  Hum=%.1f %%", temp, hum);
 
-                int sock = socket(AF_INET, SOCK_STREAM, 0);
-                if (sock >= 0)
-                {
-                    struct sockaddr_in dest = {0};
-                    dest.sin_family = AF_INET;
-                    dest.sin_port   = htons(GATEWAY_PORT);
-                    inet_pton(AF_INET, GATEWAY_IP, &dest.sin_addr);
-
-                    if (connect(sock,
-                                (struct sockaddr*)&dest,
-                                sizeof(dest)) == 0)
-                    {
-                        char msg[64];
-                        snprintf(msg, sizeof(msg),
-                                 "DEV=%d,TYPE=ENV,TEMP=%.1f,HUM=%.1f\n",
-                                 DEVICE_ID, temp, hum);
+                char msg[112];
+                int len = snprintf(msg, sizeof(msg),
+                                   "DEV=%d,TYPE=ENV,TEMP=%.1f,HUM=%.1f,SEQ=%lu,TS=%llu\n",
+                                   DEVICE_ID, temp, hum, (unsigned long)frame_seq++,
+                                   (unsigned long long)device_time_ms());
 
-                        send(sock, msg, strlen(msg), 0);
-                    }
-                    else
-                    {
-                        ESP_LOGW("TCP", "Connect failed: %d", errno);
-                    }
-
-                    close(sock);
-                }
+                scada_link_send(msg, len, true);
             }
             else
             {
@@ -391,8 +417,16 @@ void app_main(void)
 
     max_init();
     max_off();
+    sntp_start();
     mqtt_start();
 
+    // one kept session for every frame; sends from the tasks below only queue.
+    // A reading every 3 s: the RAM queue holds a few minutes of an outage,
+    // NVS the next few
+    struct scada_link_config link_config = SCADA_LINK_CONFIG_DEFAULT;
+    link_config.spill_frames = SPILL_FRAMES;
+    scada_link_start(GATEWAY_IP, GATEWAY_PORT, &link_config);
+
     printf("WiFi connected, starting sensor loop\n");
 
     xTaskCreate(dht_tcp_task,
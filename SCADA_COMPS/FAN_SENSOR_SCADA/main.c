@@ -15,8 +15,9 @@
 #include <errno.h>
 #include "driver/gpio.h"
 
-#include "lwip/sockets.h"
-#include "lwip/inet.h"
+#include "scada_link.h"
+#include "esp_sntp.h"
+#include <sys/time.h>
 
 #define LEDPIN GPIO_NUM_7
 #define FANPIN GPIO_NUM_6
@@ -28,6 +29,7 @@
 #define GATEWAY_IP     "x.x.x.x"  
 #define GATEWAY_PORT   9100           
 #define DEVICE_ID 2
+#define SNTP_SERVER    "pool.ntp.org"
 
 #define MQTT_URI       "mqtt://x.x.x.x:1885"
 #define MQTT_SUB_TOPIC "sensors/mosense/0/cmd"
@@ -64,6 +66,15 @@ static void wifi_event_handler(void* arg,
 }
 
 
+/* Reports the switch as applied on MQTT_PUB_TOPIC (retained, QoS 1), so
+ * the gateway sees what the device is really doing, not just what was
+ * asked for on MQTT_SUB_TOPIC. */
+static void publish_status(bool enabled)
+{
+    const char *payload = enabled ? "{\"enable\":true}" : "{\"enable\":false}";
+    esp_mqtt_client_publish(mqtt_client, MQTT_PUB_TOPIC, payload, 0, 1, 1);
+}
+
 static void mqtt_event_handler(void *arg,
                                esp_event_base_t base,
                                int32_t id,
@@ -111,6 +122,7 @@ static void mqtt_event_handler(void *arg,
                         mosenseEnabled = cJSON_IsTrue(enable);
                         ESP_LOGI(TAG, "MOSENSE %s (JSON)",
                         mosenseEnabled ? "ENABLED" : "DISABLED");
+                        publish_status(mosenseEnabled);
                         cJSON_Delete(root);
                         break;
 
@@ -120,11 +132,13 @@ static void mqtt_event_handler(void *arg,
                 if (strncmp(event->data, "ON", event->data_len) == 0)
                 {
                     mosenseEnabled = true;
+                    publish_status(mosenseEnabled);
                     
                 }
                 else if (strncmp(event->data, "OFF", event->data_len) == 0)
                 {
                     mosenseEnabled = false;
+                    publish_status(mosenseEnabled);
                 }
                 else 
                 {
@@ -239,43 +253,57 @@ static void LED_init(void)
     gpio_set_level(LEDPIN, 0);
 }
 
-static void send_sensor_state(int gpio, int state)
-{
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0)
-    {
-        ESP_LOGE(TAG, "socket() failed");
-        return;
+/* Edges carry the device time they happened at (TS=, ms since epoch) and
+ * a per-boot sequence number (SEQ=), so the gateway orders them and the
+ * DNP3 events keep the real edge time however late Wi-Fi delivers them.
+ * TS=0 until SNTP has synced; the gateway then uses its own clock. */
+static volatile bool time_synced = false;
+static uint32_t frame_seq = 0;
 
-    }
+static void time_sync_cb(struct timeval *tv)
+{
+    time_synced = true;
+}
 
-    struct sockaddr_in dest = {0};
-    dest.sin_family = AF_INET;
-    dest.sin_port = htons(GATEWAY_PORT);
-    inet_pton(AF_INET, GATEWAY_IP, &dest.sin_addr);
+static void sntp_start(void)
+{
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, SNTP_SERVER);
+    sntp_set_time_sync_notification_cb(time_sync_cb);
+    esp_sntp_init();
+}
 
-    if (connect(sock, (struct sockaddr*)&dest, sizeof(dest)) == 0)
-    {
-        char msg[64];
-        snprintf(
-            msg,
-            sizeof(msg),
-            "DEV=%d,TYPE=SENSOR,GPIO=%d,STATE=%d\n",
-            DEVICE_ID,
-            gpio,
-            state
-        );
+static uint64_t device_time_ms(void)
+{
+    if (!time_synced) return 0;
 
-        send(sock, msg, strlen(msg), 0);
-        ESP_LOGI(TAG, "Sent: %s", msg);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
 
+static void send_sensor_state(int gpio, int state, uint64_t time_ms)
+{
+    char msg[96];
+    int len = snprintf(
+        msg,
+        sizeof(msg),
+        "DEV=%d,TYPE=SENSOR,GPIO=%d,STATE=%d,SEQ=%lu,TS=%llu\n",
+        DEVICE_ID,
+        gpio,
+        state,
+        (unsigned long)frame_seq++,
+        (unsigned long long)time_ms
+    );
 
+    if (scada_link_send(msg, len, true))
+    {
+        ESP_LOGI(TAG, "Queued: %s", msg);
     }
     else
     {
-        ESP_LOGE(TAG, "TCP connect for sensor failed %d", errno);
+        ESP_LOGE(TAG, "Gateway queue full, sensor frame dropped");
     }
-    close(sock);
 }
 
 static void sensor_task(void *arg)
@@ -301,6 +329,7 @@ while(1)
 
         if (state != last_state)
         {
+            uint64_t edge_ms = device_time_ms();   // before the fan/LED work below
             if (state == 1)
             {
                 ESP_LOGI("HRSR501", "MOTION DETECTED");
@@ -314,7 +343,7 @@ while(1)
                 gpio_set_level(FANPIN, 0);
                 gpio_set_level(LEDPIN, 0);
             }
-            send_sensor_state(SENPIN, state);
+            send_sensor_state(SENPIN, state, edge_ms);
             last_state = state;
             
         }
@@ -351,8 +380,12 @@ void app_main(void)
         vTaskDelay(pdMS_TO_TICKS(200));
 
     }
+    sntp_start();
     mqtt_start();
 
+    // one kept session for every frame; sends from the tasks below only queue
+    scada_link_start(GATEWAY_IP, GATEWAY_PORT, NULL);
+
     xTaskCreate(
         sensor_task,
         "sensor_task",
@@ -4,8 +4,9 @@
 #include "driver/gpio.h"
 #include "esp_rom_sys.h"
 #include <string.h>
-#include "lwip/sockets.h"
-#include "lwip/inet.h"
+#include "scada_link.h"
+#include "esp_sntp.h"
+#include <sys/time.h>
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_netif.h"
@@ -27,6 +28,7 @@ static const char *TAG = "KEYPAD";
 #define MQTT_PUB_TOPIC "sensors/keypad/0/status"
 
 #define DEVICE_ID      1
+#define SNTP_SERVER    "pool.ntp.org"
 
 /* -------------------------
  * Keypad geometry
@@ -141,6 +143,15 @@ static void keypad_init(void)
     }
 }
 
+/* Reports the switch as applied on MQTT_PUB_TOPIC (retained, QoS 1), so
+ * the gateway sees what the device is really doing, not just what was
+ * asked for on MQTT_SUB_TOPIC. */
+static void publish_status(bool enabled)
+{
+    const char *payload = enabled ? "{\"enable\":true}" : "{\"enable\":false}";
+    esp_mqtt_client_publish(mqtt_client, MQTT_PUB_TOPIC, payload, 0, 1, 1);
+}
+
 static void mqtt_event_handler(void *arg,
                                esp_event_base_t base,
                                int32_t id,
@@ -188,6 +199,7 @@ static void mqtt_event_handler(void *arg,
                         keypadEnabled = cJSON_IsTrue(enable);
                         ESP_LOGI(TAG, "KEYPAD %s (JSON)",
                         keypadEnabled ? "ENABLED" : "DISABLED");
+                        publish_status(keypadEnabled);
                         cJSON_Delete(root);
                         break;
 
@@ -197,11 +209,13 @@ static void mqtt_event_handler(void *arg,
                 if (strncmp(event->data, "ON", event->data_len) == 0)
                 {
                     keypadEnabled = true;
+                    publish_status(keypadEnabled);
                     
                 }
                 else if (strncmp(event->data, "OFF", event->data_len) == 0)
                 {
                     keypadEnabled = false;
+                    publish_status(keypadEnabled);
                 }
                 else 
                 {
@@ -306,52 +320,59 @@ static void LED_init(void)
 
 }
 
-static void send_key(char key)
+/* Edges carry the device time they happened at (TS=, ms since epoch) and
+ * a per-boot sequence number (SEQ=), so the gateway orders them and the
+ * DNP3 events keep the real edge time however late Wi-Fi delivers them.
+ * TS=0 until SNTP has synced; the gateway then uses its own clock. */
+static volatile bool time_synced = false;
+static uint32_t frame_seq = 0;
+
+static void time_sync_cb(struct timeval *tv)
 {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) return;
+    time_synced = true;
+}
 
-    struct sockaddr_in dest = {0};
-    dest.sin_family = AF_INET;
-    dest.sin_port = htons(GATEWAY_PORT);
-    inet_pton(AF_INET, GATEWAY_IP, &dest.sin_addr);
+static void sntp_start(void)
+{
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, SNTP_SERVER);
+    sntp_set_time_sync_notification_cb(time_sync_cb);
+    esp_sntp_init();
+}
 
-    if(connect(sock, (struct sockaddr*)&dest, sizeof(dest)) == 0)
-    {
-        char msg[64];
-        snprintf(msg, sizeof(msg),
-        "DEV=%d,TYPE=KEYPAD,KEY=%c\n",
-        DEVICE_ID, key);
+static uint64_t device_time_ms(void)
+{
+    if (!time_synced) return 0;
 
-        send(sock, msg, strlen(msg), 0);
-    }
-    close(sock);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
-static void send_CorInc(const char *entered, const char *passcode, int passcode_len)
+static void send_key(char key, uint64_t time_ms)
 {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) return;
+    char msg[96];
+    int len = snprintf(msg, sizeof(msg),
+    "DEV=%d,TYPE=KEYPAD,KEY=%c,SEQ=%lu,TS=%llu\n",
+    DEVICE_ID, key, (unsigned long)frame_seq++, (unsigned long long)time_ms);
 
-    struct sockaddr_in dest = {0};
-    dest.sin_family = AF_INET;
-    dest.sin_port = htons(GATEWAY_PORT);
-    inet_pton(AF_INET, GATEWAY_IP, &dest.sin_addr);
+    scada_link_send(msg, len, true);
+}
 
-    if(connect(sock, (struct sockaddr*)&dest, sizeof(dest)) == 0)
+static void send_CorInc(const char *entered, const char *passcode, int passcode_len)
+{
+    // newline-terminated: the session is shared with the key frames.
+    // No SEQ=, so the link never resends these after a reconnect
+    if(strncmp(entered, passcode, passcode_len) == 0)
     {
-        if(strncmp(entered, passcode, passcode_len) == 0)
-        {
-            char correct[17] = "PASSWORD_CORRECT";
-            send(sock, correct, strlen(correct), 0);
-        }
-        else
-        {
-            char incorrect[19] = "PASSWORD_INCORRECT";
-            send(sock, incorrect, strlen(incorrect), 0);
-        }
+        const char correct[] = "PASSWORD_CORRECT\n";
+        scada_link_send(correct, strlen(correct), false);
+    }
+    else
+    {
+        const char incorrect[] = "PASSWORD_INCORRECT\n";
+        scada_link_send(incorrect, strlen(incorrect), false);
     }
-    close(sock);
 
 }
 
@@ -385,6 +406,7 @@ static void send_keypad(void *pvParameters)
 
         if(keypadEnabled){
         keypad_key_t key = keypad_getkey();
+        uint64_t press_ms = device_time_ms();
         if(changeCheck == true){
             ESP_LOGI(TAG, "Keypad enabled");
             changeCheck = false;
@@ -393,7 +415,7 @@ static void send_keypad(void *pvParameters)
             char ch = (key < 17) ? key_to_char[key] : '?';
             ESP_LOGI(TAG, "Key pressed:%c", ch);
 
-            send_key(ch);
+            send_key(ch, press_ms);
             /* '*' resets input */
             if (ch == '*') {
                 ESP_LOGI(TAG, "Input reset");
@@ -502,8 +524,12 @@ void app_main(void)
         vTaskDelay(pdMS_TO_TICKS(200));
         retries++;
     }
+    sntp_start();
     mqtt_start();
 
+    // one kept session for every frame; sends from the tasks below only queue
+    scada_link_start(GATEWAY_IP, GATEWAY_PORT, NULL);
+
     xTaskCreate(
         send_keypad,
         "send_keypad",
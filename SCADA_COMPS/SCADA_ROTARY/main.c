@@ -5,14 +5,15 @@
 #include "driver/gpio.h"
 #include "esp_rom_sys.h"
 #include <string.h>
-#include "lwip/sockets.h"
-#include "lwip/inet.h"
+#include "scada_link.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "nvs_flash.h"
 #include "cJSON.h"
 #include "mqtt_client.h"
+#include "esp_sntp.h"
+#include <sys/time.h>
 #include <errno.h>
 
 
@@ -22,6 +23,7 @@
 
 #define GATEWAY_IP     "x.x.x.x"
 #define GATEWAY_PORT   9100
+#define SNTP_SERVER    "pool.ntp.org"
 
 #define MQTT_URI       "mqtt://x.x.x.x:1885"
 #define MQTT_SUB_TOPIC "sensors/rotary/0/cmd"
@@ -57,6 +59,15 @@ static volatile bool rotaryEnabled = false;
 static esp_mqtt_client_handle_t mqtt_client;
 
 
+/* Reports the switch as applied on MQTT_PUB_TOPIC (retained, QoS 1), so
+ * the gateway sees what the device is really doing, not just what was
+ * asked for on MQTT_SUB_TOPIC. */
+static void publish_status(bool enabled)
+{
+    const char *payload = enabled ? "{\"enable\":true}" : "{\"enable\":false}";
+    esp_mqtt_client_publish(mqtt_client, MQTT_PUB_TOPIC, payload, 0, 1, 1);
+}
+
 static void mqtt_event_handler(void *arg,
                                esp_event_base_t base,
                                int32_t id,
@@ -104,6 +115,7 @@ static void mqtt_event_handler(void *arg,
                         rotaryEnabled = cJSON_IsTrue(enable);
                         ESP_LOGI(TAG, "ROTARY %s (JSON)",
                         rotaryEnabled ? "ENABLED" : "DISABLED");
+                        publish_status(rotaryEnabled);
                         cJSON_Delete(root);
                         break;
 
@@ -113,11 +125,13 @@ static void mqtt_event_handler(void *arg,
                 if (strncmp(event->data, "ON", event->data_len) == 0)
                 {
                     rotaryEnabled = true;
+                    publish_status(rotaryEnabled);
                     
                 }
                 else if (strncmp(event->data, "OFF", event->data_len) == 0)
                 {
                     rotaryEnabled = false;
+                    publish_status(rotaryEnabled);
                 }
                 else 
                 {
@@ -373,6 +387,49 @@ static void sevenSeg_RightAc(int digit)
     }
 }
 
+/* Steps carry the device time they happened at (TS=, ms since epoch) and
+ * a per-boot sequence number (SEQ=), so steps queued through a gateway
+ * outage keep their time and the ones the link resends after a reconnect
+ * are dropped by the gateway as duplicates. TS=0 until SNTP has synced;
+ * the gateway then uses its own clock. */
+static volatile bool time_synced = false;
+static uint32_t frame_seq = 0;
+
+static void time_sync_cb(struct timeval *tv)
+{
+    time_synced = true;
+}
+
+static void sntp_start(void)
+{
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, SNTP_SERVER);
+    sntp_set_time_sync_notification_cb(time_sync_cb);
+    esp_sntp_init();
+}
+
+static uint64_t device_time_ms(void)
+{
+    if (!time_synced) return 0;
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// queued for the link task, the encoder loop never waits on the network
+static void send_rotary(int left, int right, uint64_t time_ms)
+{
+    char msg[96];
+    int len = snprintf(msg, sizeof(msg),
+                       "DEV=%d,TYPE=ROTARY,L=%d,R=%d,SEQ=%lu,TS=%llu\n",
+                       DEVICE_ID, left, right, (unsigned long)frame_seq++,
+                       (unsigned long long)time_ms);
+
+    if (!scada_link_send(msg, len, true))
+        ESP_LOGW(TAG, "Gateway queue full, rotary frame dropped");
+}
+
 static void encoder_task(void *arg)
 {
 
@@ -391,6 +448,7 @@ int delta;
             if (!xQueueReceive(encoderQueue, &delta, pdMS_TO_TICKS(200))) {
                 continue;
             }
+            uint64_t step_ms = device_time_ms();   // before the display sweep below
             if (delta > 0) {
                 ESP_LOGI(TAG, "LEFT");
                 RightAc = 0;
@@ -408,28 +466,7 @@ int delta;
                 sevenSeg_RightAc(4);
                 sys_delay_ms(2);
 
-                
-                int sock = socket(AF_INET, SOCK_STREAM, 0);
-                if (sock >= 0) {
-                    struct sockaddr_in dest = {0};
-                    dest.sin_family = AF_INET;
-                    dest.sin_port   = htons(GATEWAY_PORT);
-                    inet_pton(AF_INET, GATEWAY_IP, &dest.sin_addr);
-
-                    if (connect(sock,
-                                (struct sockaddr*)&dest,
-                                sizeof(dest)) == 0)
-                    {
-                        char msg[64];
-                        snprintf(msg, sizeof(msg),
-                                 "DEV=%d,TYPE=ROTARY,L=%d,R=%d\n",
-                                 DEVICE_ID, LeftAc, RightAc);
-
-                        send(sock, msg, strlen(msg), 0);
-
-                        close(sock);
-                    }
-                }
+                send_rotary(LeftAc, RightAc, step_ms);
 
             } else {
 
@@ -447,27 +484,7 @@ int delta;
 
                 sevenSeg_leftAc(4);
                 sys_delay_ms(2);
-                int sock = socket(AF_INET, SOCK_STREAM, 0);
-                if (sock >= 0) {
-                    struct sockaddr_in dest = {0};
-                    dest.sin_family = AF_INET;
-                    dest.sin_port   = htons(GATEWAY_PORT);
-                    inet_pton(AF_INET, GATEWAY_IP, &dest.sin_addr);
-
-                    if (connect(sock,
-                                (struct sockaddr*)&dest,
-                                sizeof(dest)) == 0)
-                    {
-                        char msg[64];
-                        snprintf(msg, sizeof(msg),
-                                 "DEV=%d,TYPE=ROTARY,L=%d,R=%d\n",
-                                 DEVICE_ID, LeftAc, RightAc);
-
-                        send(sock, msg, strlen(msg), 0);
-
-                        close(sock);
-                    }
-                }
+                send_rotary(LeftAc, RightAc, step_ms);
             }
             vTaskDelay(pdMS_TO_TICKS(10));
         }
@@ -498,8 +515,12 @@ void app_main(void)
     }
 
 
+    sntp_start();
     mqtt_start();
 
+    // one kept session for every frame; sends from the tasks below only queue
+    scada_link_start(GATEWAY_IP, GATEWAY_PORT, NULL);
+
     xTaskCreate(encoder_task,
                 "encoder_task",
                 4096,
@@ -0,0 +1,203 @@
+#ifndef SCADA_LINK_H
+#define SCADA_LINK_H
+
+/* ================= SCADA LINK =================
+ * The one TCP session a device keeps to the gateway (GATEWAY_IP:9100),
+ * shared by every sensor task on it.
+ *
+ * Sensor tasks call scada_link_push() (or scada_link_send() on the ESP32),
+ * which only copies the frame into a ring and returns: it never connects,
+ * writes or waits on the network, so a slow or missing gateway cannot
+ * stall a sensor loop. One link task owns the socket and calls
+ * scada_link_poll():
+ *
+ *   - frames queued within batch_ms of the oldest one go out together in
+ *     one write (up to SCADA_LINK_BATCH_BYTES), so a burst of edges costs
+ *     one TCP segment instead of one per frame;
+ *   - the session is opened on demand and kept; a failed connect or write
+ *     closes it and retries after a backoff that doubles from
+ *     backoff_min_ms to backoff_max_ms;
+ *   - a frame cut by a partial write is sent again whole on the next
+ *     session. Every session opens with an empty line, so the gateway
+ *     knows it is newline-framed and drops the unterminated tail of a
+ *     broken one instead of taking it for a one-shot sender's frame.
+ *
+ * Store and forward: while the gateway is unreachable frames stay in the
+ * ring (SCADA_LINK_QUEUE_BYTES) with the device time they were taken at,
+ * and go out oldest first, a batch per write, once a session is back.
+ * When the ring is full the oldest unsent frame is handed to the optional
+ * spill store (NVS on the ESP32), or dropped without one. The store only
+ * takes SCADA_LINK_SEQUENCED frames: it resends what it holds after a
+ * break or an overflow, which only SEQ= makes safe, so a full ring drops
+ * an unsequenced frame (PASSWORD_*, ...) either way. A store write is
+ * slow, so push() only moves the frame aside (SCADA_LINK_EVICT_BYTES) and
+ * the link task writes it to the store outside the lock. Spilled frames
+ * are older than anything left in the ring, so they are sent first; the
+ * store keeps the last replay_frames of them it sent, like the ring does
+ * below.
+ *
+ * A write that returned is no proof the gateway read it: frames still in
+ * the socket buffer die with the session. So the last replay_frames
+ * frames pushed with SCADA_LINK_SEQUENCED are kept after they are
+ * written and sent again at the start of the next session. They carry
+ * SEQ=, and the gateway drops the copies it already has, so replays are
+ * idempotent. Frames without a sequence number are never resent.
+ *
+ * Plain C99 with every platform call behind struct scada_link_io, so the
+ * ring, replay and reconnect logic build and run on Linux against a stub
+ * socket layer (TCPMonitor/bench_link.cpp); scada_link_esp.c is the
+ * lwIP/FreeRTOS/NVS glue used on the ESP32.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef SCADA_LINK_QUEUE_BYTES
+#define SCADA_LINK_QUEUE_BYTES 8192   /* ring, 2 bytes of header per frame */
+#endif
+#define SCADA_LINK_BATCH_BYTES 512    /* most bytes in one write, and the largest frame */
+#define SCADA_LINK_BATCH_FRAMES 64    /* most frames in one write */
+#ifndef SCADA_LINK_EVICT_BYTES
+#define SCADA_LINK_EVICT_BYTES 1024   /* evicted frames waiting for the spill store, same entries as the ring */
+#endif
+#if SCADA_LINK_EVICT_BYTES < SCADA_LINK_BATCH_BYTES + 2
+#error "SCADA_LINK_EVICT_BYTES must hold the largest frame"
+#endif
+
+/* returned by scada_link_poll() when nothing is queued */
+#define SCADA_LINK_IDLE UINT32_MAX
+
+/* scada_link_push() flags */
+#define SCADA_LINK_SEQUENCED 0x01     /* frame carries SEQ=: safe to resend after a broken session */
+
+struct scada_link_io
+{
+    void *ctx;
+
+    /* connected socket, or -1 (the link retries after a backoff) */
+    int (*open)(void *ctx);
+    /* bytes written (may be short), or -1 when the session is broken */
+    int (*write)(void *ctx, int sock, const void *buf, size_t len);
+    void (*close)(void *ctx, int sock);
+
+    uint32_t (*now_ms)(void *ctx);
+
+    /* guard the ring between sensor tasks and the link task; may be NULL
+     * when everything runs on one thread */
+    void (*lock)(void *ctx);
+    void (*unlock)(void *ctx);
+
+    /* a frame was queued: wake the link task; may be NULL */
+    void (*wake)(void *ctx);
+
+    /* optional spill store, a FIFO behind the ring; all NULL = drop the
+     * oldest frame when the ring is full. Called from the link task only,
+     * never with the lock held, so a slow flash write stalls no push.
+     *   spill_put   keep one evicted sequenced frame (the store may drop its own oldest)
+     *   spill_read  copy whole frames, oldest first after the first `skip`,
+     *               at most cap bytes, into buf; returns the bytes and sets
+     *               *frames (0 when there are no more; a frame the store
+     *               lost may count with no bytes)
+     *   spill_drop  forget the oldest `frames` frames, they were written */
+    bool (*spill_put)(void *ctx, const void *frame, size_t len);
+    size_t (*spill_read)(void *ctx, size_t skip, void *buf, size_t cap, size_t *frames);
+    void (*spill_drop)(void *ctx, size_t frames);
+};
+
+struct scada_link_config
+{
+    uint32_t batch_ms;          /* how long the oldest frame waits for company */
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    uint16_t replay_frames;     /* sequenced frames resent on a new session, keep below the gateway's 64 */
+    uint16_t spill_frames;      /* ESP32: frames kept in NVS once the ring is full, 0 = RAM only */
+};
+
+#define SCADA_LINK_CONFIG_DEFAULT { 5, 250, 8000, 8, 0 }
+
+struct scada_link_stats
+{
+    uint32_t frames_queued;
+    uint32_t frames_sent;       /* first writes, replays not counted */
+    uint32_t frames_replayed;   /* written again on a new session */
+    uint32_t frames_spilled;    /* moved from the full ring to the spill store */
+    uint32_t frames_dropped;    /* ring full and no spill store, the frame unsequenced or the store fell
+                                   behind (may have arrived before a break), or too large */
+    uint32_t writes;            /* write calls, each one batch */
+    uint32_t connects;
+    uint32_t connect_failures;
+    uint32_t write_failures;
+};
+
+struct scada_link
+{
+    struct scada_link_config config;
+    struct scada_link_io io;
+    struct scada_link_stats stats;
+
+    int sock;
+    uint32_t backoff_ms;
+    uint32_t retry_at_ms;
+    uint32_t oldest_ms;         /* when the oldest unsent frame was pushed */
+
+    /* Ring of [u16 length | flags][frame] entries, frame ids counting up:
+     *   [head_id, send_id)  written, kept for replay (the replay tail)
+     *   [send_id, tail_id)  not written yet
+     * replay_end_id marks where the tail stood when the last session broke;
+     * frames before it are on their second trip. */
+    uint8_t ring[SCADA_LINK_QUEUE_BYTES];
+    size_t head_off, send_off, used;
+    uint32_t head_id, send_id, tail_id;
+    uint32_t replay_end_id;
+    uint32_t inflight_end_id;   /* end of the batch being written, == send_id when none */
+    bool online;                /* a session is open (ring frames written on it count as delivered) */
+    /* frames evicted from the ring for the spill store, oldest first; when
+     * the link task falls behind the oldest of them is dropped */
+    uint8_t evict[SCADA_LINK_EVICT_BYTES];
+    size_t evict_used, evict_frames;
+
+    /* link task only: the spill store state, whether the next write opens
+     * the session, the batch being written and where each frame in it ends */
+    bool spill_pending;         /* the spill store may hold unsent frames */
+    size_t spill_sent;          /* spilled frames written this session, kept for replay */
+    bool fresh;
+    uint8_t batch[SCADA_LINK_BATCH_BYTES];
+    struct { uint16_t end; uint32_t id; } batch_frames[SCADA_LINK_BATCH_FRAMES];
+};
+
+void scada_link_init(struct scada_link *link, const struct scada_link_config *config,
+                     const struct scada_link_io *io);
+
+/* any task; false when the frame can never fit (longer than a batch).
+ * A full ring makes room by spilling or dropping its oldest frame. */
+bool scada_link_push(struct scada_link *link, const void *frame, size_t len, unsigned flags);
+
+/* link task only: connect, batch and write as due; returns how many ms
+ * until it wants to run again, or SCADA_LINK_IDLE until the next push */
+uint32_t scada_link_poll(struct scada_link *link);
+
+/* link task only: close the session; unsent frames stay queued and the
+ * replay tail goes out again on the next one */
+void scada_link_disconnect(struct scada_link *link);
+
+/* frames not written yet, in the ring or on their way to the spill store
+ * (the store itself not counted) */
+size_t scada_link_queued(struct scada_link *link);
+
+#ifdef ESP_PLATFORM
+/* ESP32: one link per device, run by its own task (scada_link_esp.c) */
+bool scada_link_start(const char *gateway_ip, uint16_t port, const struct scada_link_config *config);
+bool scada_link_send(const char *frame, int len, bool sequenced);
+struct scada_link_stats scada_link_get_stats(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCADA_LINK_H */
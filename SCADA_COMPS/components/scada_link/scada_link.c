@@ -0,0 +1,447 @@
+#include "scada_link.h"
+
+#include <string.h>
+
+#define ENTRY_HEADER    2
+#define ENTRY_SEQUENCED 0x8000u
+
+static void link_lock(struct scada_link *link)
+{
+    if (link->io.lock) link->io.lock(link->io.ctx);
+}
+
+static void link_unlock(struct scada_link *link)
+{
+    if (link->io.unlock) link->io.unlock(link->io.ctx);
+}
+
+// frame ids wrap, compare them like TCP sequence numbers
+static bool id_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+/* -------------------- RING (lock held) -------------------- */
+
+static void ring_write(struct scada_link *link, size_t off, const void *src, size_t len)
+{
+    size_t first = SCADA_LINK_QUEUE_BYTES - off;
+    if (first > len) first = len;
+    memcpy(link->ring + off, src, first);
+    memcpy(link->ring, (const uint8_t*)src + first, len - first);
+}
+
+static void ring_read(const struct scada_link *link, size_t off, void *dst, size_t len)
+{
+    off %= SCADA_LINK_QUEUE_BYTES;
+    size_t first = SCADA_LINK_QUEUE_BYTES - off;
+    if (first > len) first = len;
+    memcpy(dst, link->ring + off, first);
+    memcpy((uint8_t*)dst + first, link->ring, len - first);
+}
+
+static uint16_t entry_header(const struct scada_link *link, size_t off)
+{
+    uint8_t h[ENTRY_HEADER];
+    ring_read(link, off, h, sizeof(h));
+    return (uint16_t)(h[0] | h[1] << 8);
+}
+
+static size_t entry_len(uint16_t header)
+{
+    return header & ~ENTRY_SEQUENCED;
+}
+
+static size_t entry_next(size_t off, uint16_t header)
+{
+    return (off + ENTRY_HEADER + entry_len(header)) % SCADA_LINK_QUEUE_BYTES;
+}
+
+static size_t tail_off(const struct scada_link *link)
+{
+    return (link->head_off + link->used) % SCADA_LINK_QUEUE_BYTES;
+}
+
+static size_t unsent_bytes(const struct scada_link *link)
+{
+    if (link->send_id == link->head_id) return link->used;
+    return (tail_off(link) + SCADA_LINK_QUEUE_BYTES - link->send_off) % SCADA_LINK_QUEUE_BYTES;
+}
+
+static void release_head(struct scada_link *link)
+{
+    uint16_t header = entry_header(link, link->head_off);
+    link->head_off = entry_next(link->head_off, header);
+    link->used -= ENTRY_HEADER + entry_len(header);
+    link->head_id++;
+
+    // an unsent frame went: sending resumes at the new head
+    if (id_before(link->send_id, link->head_id))
+    {
+        link->send_id = link->head_id;
+        link->send_off = link->head_off;
+    }
+    // marks never trail the ring, so they stay comparable as ids wrap
+    if (id_before(link->replay_end_id, link->head_id)) link->replay_end_id = link->head_id;
+    if (id_before(link->inflight_end_id, link->head_id)) link->inflight_end_id = link->head_id;
+}
+
+// the evicted frames wait in link->evict as [u16 length][frame] entries
+static size_t evicted_len(const struct scada_link *link)
+{
+    return (size_t)(link->evict[0] | link->evict[1] << 8);
+}
+
+static void evicted_pop(struct scada_link *link)
+{
+    size_t first = ENTRY_HEADER + evicted_len(link);
+    memmove(link->evict, link->evict + first, link->evict_used - first);
+    link->evict_used -= first;
+    link->evict_frames--;
+}
+
+// moves a frame aside for the link task to spill; the store write itself
+// is too slow for the lock
+static void evicted_push(struct scada_link *link, size_t off, size_t len)
+{
+    while (SCADA_LINK_EVICT_BYTES - link->evict_used < ENTRY_HEADER + len)
+    {
+        // the link task fell behind the store: its oldest frame goes
+        evicted_pop(link);
+        link->stats.frames_dropped++;
+    }
+    uint8_t *entry = link->evict + link->evict_used;
+    entry[0] = (uint8_t)len;
+    entry[1] = (uint8_t)(len >> 8);
+    ring_read(link, off, entry + ENTRY_HEADER, len);
+    link->evict_used += ENTRY_HEADER + len;
+    link->evict_frames++;
+}
+
+// makes room at the tail by spilling or dropping the oldest frame. Frames
+// written on the open session go quietly; one written on a session that
+// broke since may never have arrived, so it is kept like an unsent one
+// when it could be resent (sequenced). Only sequenced frames are spilled:
+// the store sends what it holds again after a break or when it overflows,
+// and the gateway would apply an unsequenced frame each time
+static void evict_head(struct scada_link *link)
+{
+    uint16_t header = entry_header(link, link->head_off);
+    bool written = id_before(link->head_id, link->send_id) ||
+                   id_before(link->head_id, link->inflight_end_id);
+    bool resend = written || id_before(link->head_id, link->replay_end_id);
+    bool owed = resend ? (header & ENTRY_SEQUENCED) && !(link->online && written) : true;
+    if (owed)
+    {
+        if (link->io.spill_put && (header & ENTRY_SEQUENCED))
+            evicted_push(link, link->head_off + ENTRY_HEADER, entry_len(header));
+        else link->stats.frames_dropped++;
+    }
+    release_head(link);
+}
+
+static void advance_send(struct scada_link *link, uint32_t to_id)
+{
+    while (id_before(link->send_id, to_id) && link->send_id != link->tail_id)
+    {
+        link->send_off = entry_next(link->send_off, entry_header(link, link->send_off));
+        link->send_id++;
+    }
+}
+
+// the replay tail keeps only the newest replay_frames sequenced frames
+static void trim_tail(struct scada_link *link)
+{
+    while (link->head_id != link->send_id)
+    {
+        uint16_t header = entry_header(link, link->head_off);
+        if ((header & ENTRY_SEQUENCED) && link->send_id - link->head_id <= link->config.replay_frames) break;
+        release_head(link);
+    }
+}
+
+/* -------------------- API -------------------- */
+
+void scada_link_init(struct scada_link *link, const struct scada_link_config *config,
+                     const struct scada_link_io *io)
+{
+    static const struct scada_link_config defaults = SCADA_LINK_CONFIG_DEFAULT;
+
+    memset(link, 0, sizeof(*link));
+    link->config = config ? *config : defaults;
+    if (link->config.backoff_min_ms == 0) link->config.backoff_min_ms = 1;
+    if (link->config.backoff_max_ms < link->config.backoff_min_ms)
+        link->config.backoff_max_ms = link->config.backoff_min_ms;
+
+    link->io = *io;
+    link->sock = -1;
+    link->backoff_ms = link->config.backoff_min_ms;
+    // a spill store may have kept frames across a reboot
+    size_t frames = 0;
+    if (io->spill_read) io->spill_read(io->ctx, 0, link->batch, sizeof(link->batch), &frames);
+    link->spill_pending = frames > 0;
+}
+
+bool scada_link_push(struct scada_link *link, const void *frame, size_t len, unsigned flags)
+{
+    if (len == 0) return true;
+
+    uint32_t now = link->io.now_ms(link->io.ctx);
+    size_t need = ENTRY_HEADER + len;
+
+    link_lock(link);
+    if (len > SCADA_LINK_BATCH_BYTES || need > SCADA_LINK_QUEUE_BYTES)
+    {
+        link->stats.frames_dropped++;
+        link_unlock(link);
+        return false;
+    }
+
+    while (SCADA_LINK_QUEUE_BYTES - link->used < need) evict_head(link);
+
+    uint16_t header = (uint16_t)len | ((flags & SCADA_LINK_SEQUENCED) ? ENTRY_SEQUENCED : 0);
+    uint8_t h[ENTRY_HEADER] = { (uint8_t)header, (uint8_t)(header >> 8) };
+    size_t off = tail_off(link);
+    ring_write(link, off, h, sizeof(h));
+    ring_write(link, (off + ENTRY_HEADER) % SCADA_LINK_QUEUE_BYTES, frame, len);
+
+    if (link->send_id == link->tail_id) link->oldest_ms = now;
+    link->used += need;
+    link->tail_id++;
+    link->stats.frames_queued++;
+    link_unlock(link);
+
+    if (link->io.wake) link->io.wake(link->io.ctx);
+    return true;
+}
+
+size_t scada_link_queued(struct scada_link *link)
+{
+    link_lock(link);
+    size_t frames = link->tail_id - link->send_id + link->evict_frames;
+    link_unlock(link);
+    return frames;
+}
+
+void scada_link_disconnect(struct scada_link *link)
+{
+    if (link->sock < 0) return;
+    link->io.close(link->io.ctx, link->sock);
+    link->sock = -1;
+    link_lock(link);
+    link->online = false;
+    link_unlock(link);
+}
+
+static uint32_t link_failed(struct scada_link *link, uint32_t now)
+{
+    scada_link_disconnect(link);
+    link->retry_at_ms = now + link->backoff_ms;
+    link->backoff_ms = link->backoff_ms >= link->config.backoff_max_ms / 2
+                           ? link->config.backoff_max_ms
+                           : link->backoff_ms * 2;
+    return link->retry_at_ms - now;
+}
+
+// the first write of a session starts with an empty line (see scada_link.h)
+static size_t session_lead(struct scada_link *link)
+{
+    if (!link->fresh) return 0;
+    link->batch[0] = '\n';
+    return 1;
+}
+
+// hands the evicted frames to the spill store, oldest first, one at a time
+// so the lock is never held through a store write
+static void spill_evicted(struct scada_link *link)
+{
+    while (1)
+    {
+        link_lock(link);
+        size_t len = link->evict_frames ? evicted_len(link) : 0;
+        if (len)
+        {
+            memcpy(link->batch, link->evict + ENTRY_HEADER, len);
+            evicted_pop(link);
+        }
+        link_unlock(link);
+        if (!len) return;
+
+        bool kept = link->io.spill_put(link->io.ctx, link->batch, len);
+        link_lock(link);
+        if (kept) link->stats.frames_spilled++;
+        else link->stats.frames_dropped++;
+        link_unlock(link);
+        if (kept)
+        {
+            link->spill_pending = true;
+            link->spill_sent = 0;      // the store may have dropped its oldest: send it all again
+        }
+    }
+}
+
+// the written spilled frames the store keeps for replay, like the ring's
+// tail: drop the oldest of them as `written` newer frames go out
+static void spill_release(struct scada_link *link, size_t written)
+{
+    size_t keep = link->config.replay_frames > written ? link->config.replay_frames - written : 0;
+    if (link->spill_sent <= keep) return;
+    link->io.spill_drop(link->io.ctx, link->spill_sent - keep);
+    link->spill_sent = keep;
+}
+
+// spilled frames go before the ring: a full ring drops its written tail
+// before it spills, so whatever is left in it is newer. False when there
+// are none left to send
+static bool send_spilled(struct scada_link *link, uint32_t now, uint32_t *wait)
+{
+    size_t frames = 0;
+    size_t lead = session_lead(link);
+    size_t bytes = link->io.spill_read(link->io.ctx, link->spill_sent, link->batch + lead,
+                                       sizeof(link->batch) - lead, &frames);
+    if (frames == 0)
+    {
+        link->spill_pending = false;
+        return false;
+    }
+
+    bytes += lead;
+    link->fresh = false;
+    int n = link->io.write(link->io.ctx, link->sock, link->batch, bytes);
+    link->stats.writes++;
+    if (n != (int)bytes)
+    {
+        // no frame boundaries here: the whole batch goes again, SEQ drops the copies
+        link->stats.write_failures++;
+        *wait = link_failed(link, now);
+        return true;
+    }
+
+    link->spill_sent += frames;
+    spill_release(link, 0);
+    link_lock(link);
+    link->stats.frames_sent += (uint32_t)frames;
+    link_unlock(link);
+    link->backoff_ms = link->config.backoff_min_ms;
+    *wait = 0;
+    return true;
+}
+
+uint32_t scada_link_poll(struct scada_link *link)
+{
+    if (link->io.spill_put) spill_evicted(link);
+    uint32_t now = link->io.now_ms(link->io.ctx);
+
+    link_lock(link);
+    size_t frames = link->tail_id - link->send_id;
+    size_t bytes = unsent_bytes(link);
+    bool replaying = id_before(link->send_id, link->replay_end_id);
+    uint32_t waited = now - link->oldest_ms;
+    link_unlock(link);
+    bool spilled = link->spill_pending && link->io.spill_read;
+
+    if (frames == 0 && !spilled) return SCADA_LINK_IDLE;
+
+    // hold fresh frames for batch_ms unless a full batch is already here;
+    // a backlog (replay, spill) goes at once
+    if (!replaying && !spilled && waited < link->config.batch_ms && bytes < SCADA_LINK_BATCH_BYTES)
+        return link->config.batch_ms - waited;
+
+    if (link->sock < 0)
+    {
+        if ((int32_t)(now - link->retry_at_ms) < 0) return link->retry_at_ms - now;
+
+        link->sock = link->io.open(link->io.ctx);
+        if (link->sock < 0)
+        {
+            link->stats.connect_failures++;
+            return link_failed(link, now);
+        }
+        link->stats.connects++;
+
+        // new session: both replay tails go out again, spilled frames first
+        link_lock(link);
+        if (id_before(link->replay_end_id, link->send_id)) link->replay_end_id = link->send_id;
+        link->send_id = link->head_id;
+        link->send_off = link->head_off;
+        link->inflight_end_id = link->send_id;
+        link->online = true;
+        link_unlock(link);
+        link->fresh = true;
+        // the spilled frames it kept for replay go again too
+        if (link->spill_sent) link->spill_pending = true;
+        link->spill_sent = 0;
+        spilled = link->spill_pending && link->io.spill_read;
+    }
+
+    uint32_t wait;
+    if (spilled && send_spilled(link, now, &wait)) return wait;
+
+    // copy whole frames up to one batch; pushes may evict while we write
+    size_t count = 0;
+    bytes = session_lead(link);
+    link_lock(link);
+    size_t off = link->send_off;
+    uint32_t first_id = link->send_id;
+    uint32_t id = first_id;
+    while (id != link->tail_id && count < SCADA_LINK_BATCH_FRAMES)
+    {
+        uint16_t header = entry_header(link, off);
+        size_t len = entry_len(header);
+        bool resend = id_before(id, link->replay_end_id);
+        if (link->evict_frames) break;    // evicted meanwhile, those go first, through the store
+
+        if (!resend || (header & ENTRY_SEQUENCED))
+        {
+            if (bytes + len > SCADA_LINK_BATCH_BYTES) break;
+            ring_read(link, off + ENTRY_HEADER, link->batch + bytes, len);
+            bytes += len;
+            link->batch_frames[count].end = (uint16_t)bytes;
+            link->batch_frames[count].id = id;
+            count++;
+        }
+        off = entry_next(off, header);
+        id++;
+    }
+    uint32_t batch_end_id = id;
+    link->inflight_end_id = batch_end_id;
+    link_unlock(link);
+
+    int n = bytes ? link->io.write(link->io.ctx, link->sock, link->batch, bytes) : 0;
+    if (bytes) link->stats.writes++;
+    link->fresh = false;
+
+    // a short write keeps what it took; the cut frame goes again whole
+    // (the gateway drops it, the session started framed)
+    uint32_t done_id = batch_end_id;
+    size_t done = count;
+    if (n != (int)bytes)
+    {
+        done = 0;
+        while (done < count && n > 0 && link->batch_frames[done].end <= (size_t)n) done++;
+        done_id = done ? link->batch_frames[done - 1].id + 1 : first_id;
+    }
+
+    link_lock(link);
+    for (size_t i = 0; i < done; ++i)
+    {
+        if (id_before(link->batch_frames[i].id, link->replay_end_id)) link->stats.frames_replayed++;
+        else link->stats.frames_sent++;
+    }
+    advance_send(link, done_id);
+    link->inflight_end_id = link->send_id;
+    trim_tail(link);
+    // whatever is left already waited a write; send it without a new window
+    if (link->send_id != link->tail_id) link->oldest_ms = now - link->config.batch_ms;
+    link_unlock(link);
+    if (link->spill_sent) spill_release(link, done);
+
+    if (n != (int)bytes)
+    {
+        link->stats.write_failures++;
+        return link_failed(link, now);
+    }
+
+    link->backoff_ms = link->config.backoff_min_ms;
+    return 0;
+}
@@ -0,0 +1,240 @@
+#include "scada_link.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "lwip/sockets.h"
+#include "lwip/inet.h"
+
+#define LINK_TASK_STACK    3072
+#define LINK_TASK_PRIORITY 4
+#define LINK_SEND_TIMEOUT_MS 2000   // a stalled gateway breaks the session instead of the task
+#define SPILL_NAMESPACE "scada_spill"
+
+static const char *TAG = "SCADA_LINK";
+
+static struct scada_link gateway_link;
+static struct sockaddr_in gateway;
+static SemaphoreHandle_t queue_mutex;
+static StaticSemaphore_t queue_mutex_buf;
+static TaskHandle_t link_task_handle;
+
+/* -------------------- lwIP / FreeRTOS IO -------------------- */
+
+static int esp_open(void *ctx)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+
+    if (connect(sock, (struct sockaddr*)&gateway, sizeof(gateway)) != 0)
+    {
+        ESP_LOGW(TAG, "Connect failed: %d", errno);
+        close(sock);
+        return -1;
+    }
+
+    // batching is done here, don't let Nagle hold a batch back
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct timeval tv = { .tv_sec = LINK_SEND_TIMEOUT_MS / 1000, .tv_usec = (LINK_SEND_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    ESP_LOGI(TAG, "Connected to gateway");
+    return sock;
+}
+
+static int esp_write(void *ctx, int sock, const void *buf, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        int n = send(sock, (const char*)buf + done, len - done, 0);
+        if (n <= 0)
+        {
+            ESP_LOGW(TAG, "Send failed: %d", errno);
+            return done ? (int)done : -1;
+        }
+        done += (size_t)n;
+    }
+    return (int)done;
+}
+
+static void esp_close(void *ctx, int sock)
+{
+    close(sock);
+}
+
+static uint32_t esp_now_ms(void *ctx)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void esp_lock(void *ctx)
+{
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+}
+
+static void esp_unlock(void *ctx)
+{
+    xSemaphoreGive(queue_mutex);
+}
+
+static void esp_wake(void *ctx)
+{
+    if (link_task_handle) xTaskNotifyGive(link_task_handle);
+}
+
+/* -------------------- NVS SPILL --------------------
+ * Frames the full ring evicts, as a FIFO of blobs f<n> (n = frame id modulo
+ * the capacity) plus head/tail ids, so an outage longer than the ring
+ * still gets sent and a reboot does not lose what was spilled. Only written
+ * while the ring is full, and only by the link task without queue_mutex:
+ * a blob write and commit can take milliseconds, and sensor tasks pushing
+ * meanwhile must not wait on them. The default NVS partition (24 KB) holds
+ * a few hundred ASCII frames, enlarge it for more.
+ */
+
+static nvs_handle_t spill_nvs;
+static uint32_t spill_head, spill_tail, spill_cap;
+
+static void spill_key(char *key, size_t size, uint32_t id)
+{
+    snprintf(key, size, "f%lu", (unsigned long)(id % spill_cap));
+}
+
+static bool spill_open(uint16_t frames)
+{
+    if (nvs_open(SPILL_NAMESPACE, NVS_READWRITE, &spill_nvs) != ESP_OK) return false;
+
+    spill_cap = frames;
+    nvs_get_u32(spill_nvs, "head", &spill_head);
+    nvs_get_u32(spill_nvs, "tail", &spill_tail);
+    if (spill_tail - spill_head > spill_cap)
+    {
+        // written with another capacity, the keys no longer line up
+        nvs_erase_all(spill_nvs);
+        spill_head = spill_tail = 0;
+    }
+    if (spill_tail != spill_head)
+        ESP_LOGI(TAG, "%lu frames spilled before the restart", (unsigned long)(spill_tail - spill_head));
+    return true;
+}
+
+static void spill_forget_head(void)
+{
+    char key[16];
+    spill_key(key, sizeof(key), spill_head);
+    nvs_erase_key(spill_nvs, key);
+    spill_head++;
+    nvs_set_u32(spill_nvs, "head", spill_head);
+}
+
+static bool esp_spill_put(void *ctx, const void *frame, size_t len)
+{
+    if (spill_tail - spill_head >= spill_cap) spill_forget_head();   // full: oldest goes
+
+    char key[16];
+    spill_key(key, sizeof(key), spill_tail);
+    if (nvs_set_blob(spill_nvs, key, frame, len) != ESP_OK) return false;
+
+    spill_tail++;
+    nvs_set_u32(spill_nvs, "tail", spill_tail);
+    nvs_commit(spill_nvs);
+    return true;
+}
+
+static size_t esp_spill_read(void *ctx, size_t skip, void *buf, size_t cap, size_t *frames)
+{
+    size_t bytes = 0;
+    *frames = 0;
+
+    for (uint32_t id = spill_head + (uint32_t)skip; (int32_t)(spill_tail - id) > 0; ++id)
+    {
+        char key[16];
+        spill_key(key, sizeof(key), id);
+        size_t len = cap - bytes;
+        esp_err_t err = nvs_get_blob(spill_nvs, key, (uint8_t*)buf + bytes, &len);
+        if (err == ESP_ERR_NVS_INVALID_LENGTH) break;      // next batch
+        if (err == ESP_OK) bytes += len;                   // else lost to a power cut mid-write
+        (*frames)++;
+    }
+    return bytes;
+}
+
+static void esp_spill_drop(void *ctx, size_t frames)
+{
+    while (frames-- && spill_head != spill_tail) spill_forget_head();
+    nvs_commit(spill_nvs);
+}
+
+/* -------------------- LINK TASK -------------------- */
+
+static void link_task(void *arg)
+{
+    uint32_t wait_ms = SCADA_LINK_IDLE;
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, wait_ms == SCADA_LINK_IDLE ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms));
+        wait_ms = scada_link_poll(&gateway_link);
+        if (wait_ms == 0) wait_ms = 1;    // let the sensor tasks in between batches
+    }
+}
+
+bool scada_link_start(const char *gateway_ip, uint16_t port, const struct scada_link_config *config)
+{
+    if (link_task_handle) return true;
+
+    memset(&gateway, 0, sizeof(gateway));
+    gateway.sin_family = AF_INET;
+    gateway.sin_port   = htons(port);
+    if (inet_pton(AF_INET, gateway_ip, &gateway.sin_addr) != 1)
+    {
+        ESP_LOGE(TAG, "Bad gateway address %s", gateway_ip);
+        return false;
+    }
+
+    queue_mutex = xSemaphoreCreateMutexStatic(&queue_mutex_buf);
+
+    struct scada_link_io io = {
+        .ctx    = NULL,
+        .open   = esp_open,
+        .write  = esp_write,
+        .close  = esp_close,
+        .now_ms = esp_now_ms,
+        .lock   = esp_lock,
+        .unlock = esp_unlock,
+        .wake   = esp_wake,
+    };
+    if (config && config->spill_frames && spill_open(config->spill_frames))
+    {
+        io.spill_put  = esp_spill_put;
+        io.spill_read = esp_spill_read;
+        io.spill_drop = esp_spill_drop;
+    }
+    scada_link_init(&gateway_link, config, &io);
+
+    return xTaskCreate(link_task, "scada_link", LINK_TASK_STACK, NULL, LINK_TASK_PRIORITY,
+                       &link_task_handle) == pdPASS;
+}
+
+bool scada_link_send(const char *frame, int len, bool sequenced)
+{
+    if (!link_task_handle || len <= 0) return false;
+    return scada_link_push(&gateway_link, frame, (size_t)len, sequenced ? SCADA_LINK_SEQUENCED : 0);
+}
+
+struct scada_link_stats scada_link_get_stats(void)
+{
+    esp_lock(NULL);
+    struct scada_link_stats stats = gateway_link.stats;
+    esp_unlock(NULL);
+    return stats;
+}
@@ -0,0 +1,267 @@
+#ifndef SCADA_WIRE_H
+#define SCADA_WIRE_H
+
+/* ================= SCADA WIRE FORMAT =================
+ * Fixed-layout binary frame shared by the ESP32 firmware (encoder) and
+ * the Pi gateway (decoder). Plain C99, header only, no ESP-IDF or libc
+ * dependencies beyond <stdint.h>/<string.h>, so both sides compile it on
+ * Linux for testing.
+ *
+ * All frames are SCADA_WIRE_FRAME_SIZE bytes, little-endian:
+ *
+ *   off size field
+ *     0   2  magic     0xA5 0x5C (0xA5 is never the first byte of an ASCII frame)
+ *     2   1  version   SCADA_WIRE_VERSION
+ *     3   1  type      enum scada_wire_type
+ *     4   2  dev       DEV id
+ *     6   4  seq       per-device sequence number
+ *    10   8  time_ms   device time in ms since epoch, 0 = not known
+ *    18   8  payload   type specific, see below
+ *    26   2  crc       CRC-16/CCITT-FALSE over bytes 0..25
+ *
+ * Payload:
+ *   ENV      f32 temp, f32 hum
+ *   KEYPAD   u8 key (ASCII)
+ *   SENSOR   u8 gpio, u8 state
+ *   ROTARY   u8 left, u8 right
+ *   PASSCODE u8 ok
+ * Unused payload bytes are zero.
+ *
+ * The gateway accepts these frames on the same TCP port as the
+ * "DEV=..,TYPE=..\n" text frames and tells them apart by the first byte.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCADA_WIRE_MAGIC0     0xA5
+#define SCADA_WIRE_MAGIC1     0x5C
+#define SCADA_WIRE_VERSION    1
+#define SCADA_WIRE_FRAME_SIZE 28
+
+enum scada_wire_type
+{
+    SCADA_WIRE_ENV      = 1,
+    SCADA_WIRE_KEYPAD   = 2,
+    SCADA_WIRE_SENSOR   = 3,
+    SCADA_WIRE_ROTARY   = 4,
+    SCADA_WIRE_PASSCODE = 5
+};
+
+enum scada_wire_status
+{
+    SCADA_WIRE_OK = 0,
+    SCADA_WIRE_SHORT,       /* fewer than SCADA_WIRE_FRAME_SIZE bytes */
+    SCADA_WIRE_BAD_MAGIC,
+    SCADA_WIRE_BAD_VERSION,
+    SCADA_WIRE_BAD_CRC,
+    SCADA_WIRE_BAD_TYPE
+};
+
+struct scada_wire_frame
+{
+    uint8_t  type;
+    uint16_t dev;
+    uint32_t seq;
+    uint64_t time_ms;
+
+    union
+    {
+        struct { float temp, hum; } env;
+        struct { char key; } keypad;
+        struct { uint8_t gpio, state; } sensor;
+        struct { uint8_t left, right; } rotary;
+        struct { uint8_t ok; } passcode;
+    } u;
+};
+
+/* ================= HELPERS ================= */
+
+static inline uint16_t scada_wire_crc16(const uint8_t *data, size_t len)
+{
+    /* CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), byte table */
+    static const uint16_t table[256] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+        0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+        0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+        0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+        0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+        0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+        0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+        0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+        0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+        0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+        0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+        0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+        0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+        0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+        0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+        0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+        0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+        0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+        0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+        0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+        0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+        0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+        0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+        0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+        0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+        0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+        0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+        0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+        0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+        0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+        0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+    };
+    uint16_t crc = 0xFFFF;
+
+    for (size_t i = 0; i < len; i++)
+        crc = (uint16_t)((crc << 8) ^ table[((crc >> 8) ^ data[i]) & 0xFF]);
+    return crc;
+}
+
+static inline void scada_wire_put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void scada_wire_put32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline void scada_wire_put64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint16_t scada_wire_get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t scada_wire_get32(const uint8_t *p)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline uint64_t scada_wire_get64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static inline void scada_wire_putf(uint8_t *p, float f)
+{
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    scada_wire_put32(p, v);
+}
+
+static inline float scada_wire_getf(const uint8_t *p)
+{
+    uint32_t v = scada_wire_get32(p);
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+/* ================= ENCODE / DECODE ================= */
+
+/* Writes exactly SCADA_WIRE_FRAME_SIZE bytes to out; returns that size. */
+static inline size_t scada_wire_encode(const struct scada_wire_frame *f, uint8_t *out)
+{
+    memset(out, 0, SCADA_WIRE_FRAME_SIZE);
+    out[0] = SCADA_WIRE_MAGIC0;
+    out[1] = SCADA_WIRE_MAGIC1;
+    out[2] = SCADA_WIRE_VERSION;
+    out[3] = f->type;
+    scada_wire_put16(out + 4, f->dev);
+    scada_wire_put32(out + 6, f->seq);
+    scada_wire_put64(out + 10, f->time_ms);
+
+    uint8_t *pl = out + 18;
+    switch (f->type)
+    {
+    case SCADA_WIRE_ENV:
+        scada_wire_putf(pl, f->u.env.temp);
+        scada_wire_putf(pl + 4, f->u.env.hum);
+        break;
+    case SCADA_WIRE_KEYPAD:
+        pl[0] = (uint8_t)f->u.keypad.key;
+        break;
+    case SCADA_WIRE_SENSOR:
+        pl[0] = f->u.sensor.gpio;
+        pl[1] = f->u.sensor.state;
+        break;
+    case SCADA_WIRE_ROTARY:
+        pl[0] = f->u.rotary.left;
+        pl[1] = f->u.rotary.right;
+        break;
+    case SCADA_WIRE_PASSCODE:
+        pl[0] = f->u.passcode.ok;
+        break;
+    default:
+        break;
+    }
+
+    scada_wire_put16(out + 26, scada_wire_crc16(out, 26));
+    return SCADA_WIRE_FRAME_SIZE;
+}
+
+static inline enum scada_wire_status scada_wire_decode(const uint8_t *in, size_t len,
+                                                       struct scada_wire_frame *f)
+{
+    if (len < SCADA_WIRE_FRAME_SIZE) return SCADA_WIRE_SHORT;
+    if (in[0] != SCADA_WIRE_MAGIC0 || in[1] != SCADA_WIRE_MAGIC1) return SCADA_WIRE_BAD_MAGIC;
+    if (in[2] != SCADA_WIRE_VERSION) return SCADA_WIRE_BAD_VERSION;
+    if (scada_wire_get16(in + 26) != scada_wire_crc16(in, 26)) return SCADA_WIRE_BAD_CRC;
+
+    memset(f, 0, sizeof(*f));
+    f->type = in[3];
+    f->dev = scada_wire_get16(in + 4);
+    f->seq = scada_wire_get32(in + 6);
+    f->time_ms = scada_wire_get64(in + 10);
+
+    const uint8_t *pl = in + 18;
+    switch (f->type)
+    {
+    case SCADA_WIRE_ENV:
+        f->u.env.temp = scada_wire_getf(pl);
+        f->u.env.hum = scada_wire_getf(pl + 4);
+        break;
+    case SCADA_WIRE_KEYPAD:
+        f->u.keypad.key = (char)pl[0];
+        break;
+    case SCADA_WIRE_SENSOR:
+        f->u.sensor.gpio = pl[0];
+        f->u.sensor.state = pl[1];
+        break;
+    case SCADA_WIRE_ROTARY:
+        f->u.rotary.left = pl[0];
+        f->u.rotary.right = pl[1];
+        break;
+    case SCADA_WIRE_PASSCODE:
+        f->u.passcode.ok = pl[0];
+        break;
+    default:
+        return SCADA_WIRE_BAD_TYPE;
+    }
+    return SCADA_WIRE_OK;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCADA_WIRE_H */
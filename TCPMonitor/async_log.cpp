@@ -0,0 +1,233 @@
+#include "async_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <strings.h>
+
+static constexpr size_t OUT_BUFFER = 64 * 1024;
+static constexpr size_t LINE_MAX = 256;
+static constexpr auto IDLE_SLEEP = std::chrono::milliseconds(2);
+
+AsyncLog::AsyncLog(size_t capacity)
+{
+    size_t n = 2;
+    while (n < capacity) n <<= 1;
+
+    cells_.reset(new Cell[n]);
+    mask_ = n - 1;
+    for (size_t i = 0; i < n; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+AsyncLog::~AsyncLog()
+{
+    stop();
+}
+
+void AsyncLog::start(FILE* sink)
+{
+    if (running_.exchange(true)) return;
+    sink_ = sink;
+    flusher_ = std::thread(&AsyncLog::flush_loop, this);
+}
+
+void AsyncLog::stop()
+{
+    if (!running_.exchange(false)) return;
+    flusher_.join();
+}
+
+/* -------------------- RING -------------------- */
+
+bool AsyncLog::push(const Record& r)
+{
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Cell* c;
+
+    for (;;)
+    {
+        c = &cells_[pos & mask_];
+        size_t seq = c->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if (diff == 0)
+        {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // full: the flusher has not reached this cell yet
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    c->rec = r;
+    c->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool AsyncLog::pop(Record& r)
+{
+    Cell& c = cells_[tail_ & mask_];
+    if (c.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+
+    r = c.rec;
+    c.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+    ++tail_;
+    return true;
+}
+
+/* -------------------- PRODUCERS -------------------- */
+
+void AsyncLog::env(int dev, float temp, float hum)
+{
+    if (!enabled(LogLevel::Info)) return;
+    Record r;
+    r.kind = Kind::Env;
+    r.level = LogLevel::Info;
+    r.dev = dev;
+    r.env.temp = temp;
+    r.env.hum = hum;
+    push(r);
+}
+
+void AsyncLog::keypad(int dev, char key)
+{
+    if (!enabled(LogLevel::Info)) return;
+    Record r;
+    r.kind = Kind::Keypad;
+    r.level = LogLevel::Info;
+    r.dev = dev;
+    r.key = key;
+    push(r);
+}
+
+void AsyncLog::motion(int dev, int state)
+{
+    if (!enabled(LogLevel::Info)) return;
+    Record r;
+    r.kind = Kind::Motion;
+    r.level = LogLevel::Info;
+    r.dev = dev;
+    r.state = state;
+    push(r);
+}
+
+void AsyncLog::rotary(int dev, int left, int right)
+{
+    if (!enabled(LogLevel::Info)) return;
+    Record r;
+    r.kind = Kind::Rotary;
+    r.level = LogLevel::Info;
+    r.dev = dev;
+    r.rotary.left = left;
+    r.rotary.right = right;
+    push(r);
+}
+
+void AsyncLog::text(LogLevel level, std::string_view msg)
+{
+    text(level, {}, msg);
+}
+
+void AsyncLog::text(LogLevel level, std::string_view prefix, std::string_view msg)
+{
+    if (!enabled(level)) return;
+    Record r;
+    r.kind = Kind::Text;
+    r.level = level;
+    r.dev = -1;
+
+    size_t a = std::min(prefix.size(), TEXT_MAX);
+    size_t b = std::min(msg.size(), TEXT_MAX - a);
+    memcpy(r.text, prefix.data(), a);
+    memcpy(r.text + a, msg.data(), b);
+    r.len = static_cast<uint16_t>(a + b);
+    push(r);
+}
+
+/* -------------------- FLUSHER -------------------- */
+
+// same text std::cout printed before, "%g" matches the default float format
+size_t AsyncLog::format(const Record& r, char* out, size_t room) const
+{
+    int n = 0;
+    switch (r.kind)
+    {
+    case Kind::Env:
+        n = snprintf(out, room, "[ENV] T=%g H=%g DEV=%d\n", r.env.temp, r.env.hum, r.dev);
+        break;
+    case Kind::Keypad:
+        n = snprintf(out, room, "[KEYPAD] key=%c DEV=%d\n", r.key, r.dev);
+        break;
+    case Kind::Motion:
+        n = snprintf(out, room, "[HCSR501] STATE: %d DEV=%d\n", r.state, r.dev);
+        break;
+    case Kind::Rotary:
+        n = snprintf(out, room, "[ROTARY] LEFT ACTIVE: %d RIGHT ACTIVE: %d DEV=%d\n",
+                     r.rotary.left, r.rotary.right, r.dev);
+        break;
+    case Kind::Text:
+        n = snprintf(out, room, "%.*s\n", static_cast<int>(r.len), r.text);
+        break;
+    }
+    return n > 0 ? std::min(static_cast<size_t>(n), room - 1) : 0;
+}
+
+void AsyncLog::flush_loop()
+{
+    std::unique_ptr<char[]> buf(new char[OUT_BUFFER]);
+    uint64_t reported_drops = 0;
+    Record r;
+
+    for (;;)
+    {
+        bool stopping = !running_.load(std::memory_order_acquire);
+        size_t used = 0;
+
+        while (pop(r))
+        {
+            used += format(r, buf.get() + used, LINE_MAX);
+            if (used + LINE_MAX > OUT_BUFFER)
+            {
+                fwrite(buf.get(), 1, used, sink_);
+                used = 0;
+            }
+        }
+
+        uint64_t drops = dropped_.load(std::memory_order_relaxed);
+        if (drops != reported_drops)
+        {
+            int n = snprintf(buf.get() + used, LINE_MAX, "[LOG] dropped %llu records\n",
+                             static_cast<unsigned long long>(drops - reported_drops));
+            used += std::min(static_cast<size_t>(std::max(n, 0)), LINE_MAX - 1);
+            reported_drops = drops;
+        }
+
+        if (used)
+        {
+            fwrite(buf.get(), 1, used, sink_);
+            fflush(sink_);
+        }
+
+        // a record pushed after the final drain is lost, as after exit
+        if (stopping) return;
+        if (!used) std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+}
+
+LogLevel parse_log_level(const char* name, LogLevel fallback)
+{
+    if (!name) return fallback;
+    if (strcasecmp(name, "debug") == 0) return LogLevel::Debug;
+    if (strcasecmp(name, "info") == 0)  return LogLevel::Info;
+    if (strcasecmp(name, "warn") == 0)  return LogLevel::Warn;
+    if (strcasecmp(name, "error") == 0) return LogLevel::Error;
+    return fallback;
+}
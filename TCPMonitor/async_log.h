@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string_view>
+#include <thread>
+
+/* -------------------- ASYNC LOG --------------------
+ * Ingest logging without console I/O on the ingest thread. Callers write
+ * a fixed 128-byte record into a bounded lock-free MPSC ring (Vyukov
+ * sequence-per-cell queue) and return; a background thread formats the
+ * records and writes them to the sink in large chunks.
+ *
+ * Device readings are stored as compact typed records (a few numbers) and
+ * only turned into text on the flusher thread, in the format std::cout
+ * printed ([ENV] T=23 H=41 DEV=0, ..., as in LogExamples/gateway.log).
+ * Other messages are copied as text, truncated to TEXT_MAX.
+ *
+ * Nothing here blocks: when the ring is full the record is dropped and
+ * counted, and the flusher reports the count as "[LOG] dropped N records".
+ */
+
+enum class LogLevel : uint8_t
+{
+    Debug,
+    Info,
+    Warn,
+    Error
+};
+
+class AsyncLog
+{
+public:
+    static constexpr size_t TEXT_MAX = 112;
+
+    explicit AsyncLog(size_t capacity = 8192);   // rounded up to a power of two
+    ~AsyncLog();
+
+    AsyncLog(const AsyncLog&) = delete;
+    AsyncLog& operator=(const AsyncLog&) = delete;
+
+    void start(FILE* sink = stdout);
+    void stop();    // drains everything queued so far
+
+    void set_level(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+    // device readings, Info level
+    void env(int dev, float temp, float hum);
+    void keypad(int dev, char key);
+    void motion(int dev, int state);
+    void rotary(int dev, int left, int right);
+
+    void text(LogLevel level, std::string_view msg);
+    void text(LogLevel level, std::string_view prefix, std::string_view msg);
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    enum class Kind : uint8_t
+    {
+        Text,
+        Env,
+        Keypad,
+        Motion,
+        Rotary
+    };
+
+    struct Record
+    {
+        Kind kind;
+        LogLevel level;
+        uint16_t len;
+        int32_t dev;
+        union
+        {
+            struct { float temp, hum; } env;
+            struct { int32_t left, right; } rotary;
+            int32_t state;
+            char key;
+            char text[TEXT_MAX];
+        };
+    };
+
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> seq;
+        Record rec;
+    };
+
+    bool push(const Record& r);
+    bool pop(Record& r);
+    size_t format(const Record& r, char* out, size_t room) const;
+    void flush_loop();
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0};   // producers
+    alignas(64) size_t tail_ = 0;               // flusher only
+
+    std::atomic<LogLevel> level_{LogLevel::Info};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> running_{false};
+    std::thread flusher_;
+    FILE* sink_ = stdout;
+};
+
+LogLevel parse_log_level(const char* name, LogLevel fallback);
@@ -0,0 +1,335 @@
+/* -------------------- EVENT BANDWIDTH --------------------
+ * Estimates the DNP3 traffic a point map produces, so classes, deadbands
+ * and variations can be compared without a master on the wire. The same
+ * simulated day is replayed against the map before per-point tuning
+ * (class 1 everywhere, no deadband, g30v1/g32v7/g20v1/g22v5) and against
+ * the map being tested:
+ *
+ *   ./bench_events [hours] [map] [devices]
+ *
+ * Devices follow loadgen's default mix and rates: 4 ENV (DHT every 3 s,
+ * readings drifting over the day with +-0.1 sensor jitter), 1 KEYPAD,
+ * 1 SENSOR, 1 ROTARY; `devices` (default 16) sets the size of the
+ * outstation database an integrity poll returns.
+ *
+ * Two master modes are counted: unsolicited (one response and confirm per
+ * frame that raised events, integrity every 5 min) and polled (before: all
+ * classes every 2 s, as ./master poll used to; after: class 1 every 2 s,
+ * class 2/3 every 30 s, integrity every 5 min). Bytes include application
+ * and object headers, 2-byte indices, transport headers and link framing
+ * with CRCs, so they match a capture of the channel to within a few
+ * percent; the gateway's [LINK] line and the master's give the real figure.
+ */
+
+#include "frame_parser.h"
+#include "point_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+// the built-in map before classes, deadbands and variations were tuned
+static const char BEFORE_MAP[] = R"(
+block analog  5
+block binary  1
+block counter 1
+online 0
+point ENV    TEMP  analog  0 class=1 rollup
+point ENV    HUM   analog  1 class=1 rollup
+point SENSOR STATE analog  2 class=1
+point ROTARY L     analog  3 class=1
+point ROTARY R     analog  4 class=1
+point KEYPAD KEY   counter 0 class=1 event=every
+)";
+
+/* -------------------- DNP3 SIZES -------------------- */
+
+static size_t static_size(PointKind kind, uint8_t var)
+{
+    switch (kind)
+    {
+    case PointKind::Binary:  return 1;     // g1v1 packs 8 per byte, close enough for one online bit
+    case PointKind::Analog:
+    {
+        static const size_t g30[] = { 5, 3, 4, 2, 5, 9 };
+        return g30[var - 1];
+    }
+    default:
+        return var == 1 ? 5 : var == 2 ? 3 : var == 5 ? 4 : 2;
+    }
+}
+
+static size_t event_size(PointKind kind, uint8_t var)
+{
+    switch (kind)
+    {
+    case PointKind::Binary:  return var == 1 ? 1 : var == 2 ? 7 : 3;
+    case PointKind::Analog:
+    {
+        static const size_t g32[] = { 5, 3, 11, 9, 5, 9, 11, 15 };
+        return g32[var - 1];
+    }
+    default:
+        return var == 1 ? 5 : var == 2 ? 3 : var == 5 ? 11 : 9;
+    }
+}
+
+// one application fragment on the wire: transport header, link headers
+// every 249 bytes and a CRC per 16 bytes of link user data
+static size_t wire_bytes(size_t app)
+{
+    size_t total = 0;
+    do
+    {
+        size_t chunk = std::min<size_t>(app, 249) + 1;
+        total += 10 + chunk + 2 * ((chunk + 15) / 16);
+        app -= std::min<size_t>(app, 249);
+    } while (app > 0);
+    return total;
+}
+
+static const size_t APP_HEADER = 4;        // control, function, IIN
+static const size_t EVENT_HEADER = 5;      // group, variation, qualifier 0x28, 2-byte count
+static const size_t RANGE_HEADER = 7;      // group, variation, qualifier 0x01, 2-byte start/stop
+static const size_t CLASS_REQUEST = 3;     // per class object header in a READ
+static const size_t CONFIRM = wire_bytes(2);
+
+struct Event
+{
+    PointKind kind;
+    uint8_t var;
+};
+
+// event response: one header per (group, variation), 2-byte index per object
+static size_t event_bytes(const std::vector<Event>& events)
+{
+    std::map<std::pair<int, int>, size_t> headers;
+    size_t bytes = 0;
+    for (const Event& e : events)
+    {
+        headers[{ static_cast<int>(e.kind), e.var }]++;
+        bytes += 2 + event_size(e.kind, e.var);
+    }
+    return bytes + headers.size() * EVENT_HEADER;
+}
+
+// class 0 data: one range header per run of equal variation
+static size_t static_bytes(const PointMap& map, size_t devices)
+{
+    size_t bytes = 0;
+    for (PointKind kind : { PointKind::Binary, PointKind::Analog, PointKind::Counter })
+    {
+        std::vector<int> var(map.points(kind, devices), 0);
+        if (kind == PointKind::Binary)
+            for (size_t dev = 0; dev < devices; ++dev) var[map.online_index(dev)] = 2;
+        for (const PointRoute& r : map.routes())
+            if (r.kind == kind)
+                for (size_t dev = 0; dev < devices; ++dev) var[map.index(dev, r)] = r.static_var;
+
+        int prev = 0;
+        for (int v : var)
+        {
+            if (v && v != prev) bytes += RANGE_HEADER;
+            if (v) bytes += static_size(kind, static_cast<uint8_t>(v));
+            prev = v;
+        }
+    }
+    return bytes;
+}
+
+/* -------------------- SIMULATED DEVICES -------------------- */
+
+struct SimFrame
+{
+    double t;           // seconds
+    int dev;
+    const char* type;
+    int fields;
+    const char* keys[2];
+    double values[2];
+};
+
+static std::vector<SimFrame> simulate(double hours, unsigned seed)
+{
+    struct Device { int dev; const char* type; double hz; };
+    static const Device devices[] = {
+        { 0, "ENV", 1.0 / 3.0 }, { 1, "ENV", 1.0 / 3.0 }, { 2, "ENV", 1.0 / 3.0 }, { 3, "ENV", 1.0 / 3.0 },
+        { 4, "KEYPAD", 0.2 }, { 5, "SENSOR", 0.5 }, { 6, "ROTARY", 2.0 }
+    };
+    static const char KEYS[] = "0123456789ABCD*#";
+
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> temp_noise(0.0, 0.07);   // DHT22: reads flicker +-0.1
+    std::normal_distribution<double> hum_noise(0.0, 0.3);
+    std::uniform_real_distribution<double> phase(0.0, 1.0);
+
+    const double day = 24 * 3600.0;
+    std::vector<SimFrame> frames;
+    for (const Device& d : devices)
+    {
+        double period = 1.0 / d.hz;
+        int motion = 0;
+        for (double t = phase(rng) * period; t < hours * 3600.0; t += period)
+        {
+            SimFrame f{ t, d.dev, d.type, 0, {}, {} };
+            std::string type = d.type;
+            if (type == "ENV")
+            {
+                double temp = 22.0 + d.dev * 0.5 + 1.5 * std::sin(2 * M_PI * t / day);
+                double hum = 45.0 + 5.0 * std::sin(2 * M_PI * t / day + 1.0);
+                f = { t, d.dev, d.type, 2, { "TEMP", "HUM" },
+                      { std::round((temp + temp_noise(rng)) * 10) / 10, std::round((hum + hum_noise(rng)) * 10) / 10 } };
+            }
+            else if (type == "KEYPAD")
+            {
+                char k = KEYS[rng() % (sizeof(KEYS) - 1)];
+                f = { t, d.dev, d.type, 1, { "KEY" }, { double(k >= '0' && k <= '9' ? k - '0' : k) } };
+            }
+            else if (type == "SENSOR")
+            {
+                if (rng() % 20 == 0) motion = !motion;
+                f = { t, d.dev, d.type, 1, { "STATE" }, { double(motion) } };
+            }
+            else
+            {
+                int left = rng() & 1;
+                f = { t, d.dev, d.type, 2, { "L", "R" }, { double(left), double(!left) } };
+            }
+            frames.push_back(f);
+        }
+    }
+
+    std::sort(frames.begin(), frames.end(), [](const SimFrame& a, const SimFrame& b) { return a.t < b.t; });
+    return frames;
+}
+
+/* -------------------- REPLAY -------------------- */
+
+struct Totals
+{
+    uint64_t events = 0;
+    uint64_t events_by_class[4] = {};
+    uint64_t bytes = 0;         // both directions
+};
+
+struct PollSchedule
+{
+    double period;
+    int classes;                // bit 0..3 = class 0..3
+};
+
+// `polls` empty = unsolicited mode with a 5 min integrity poll
+static Totals replay(const PointMap& map, const std::vector<SimFrame>& frames, size_t devices,
+                     const std::vector<PollSchedule>& polls)
+{
+    Totals out;
+    std::vector<double> last(map.points(PointKind::Analog, devices) + map.points(PointKind::Counter, devices), NAN);
+    std::vector<Event> pending[4];      // by class, polled mode
+    size_t integrity = static_bytes(map, devices);
+
+    std::vector<PollSchedule> schedule = polls.empty() ? std::vector<PollSchedule>{ { 300.0, 0xF } } : polls;
+    std::vector<double> next(schedule.size(), 0.0);
+
+    auto poll = [&](int classes) {
+        std::vector<Event> events;
+        size_t request_headers = 0;
+        for (int c = 0; c < 4; ++c)
+        {
+            if (!(classes & (1 << c))) continue;
+            ++request_headers;
+            if (c > 0) events.insert(events.end(), pending[c].begin(), pending[c].end()), pending[c].clear();
+        }
+        size_t response = APP_HEADER + event_bytes(events) + ((classes & 1) ? integrity : 0);
+        out.bytes += wire_bytes(2 + request_headers * CLASS_REQUEST) + wire_bytes(response);
+    };
+
+    Frame f;
+    MappedFrame m;
+    for (const SimFrame& s : frames)
+    {
+        for (size_t i = 0; i < schedule.size(); ++i)
+        {
+            while (next[i] <= s.t)
+            {
+                poll(schedule[i].classes);
+                next[i] += schedule[i].period;
+            }
+        }
+
+        f = Frame{};
+        f.dev = s.dev;
+        f.type_name = s.type;
+        for (int i = 0; i < s.fields; ++i) f.fields[f.field_count++] = { s.keys[i], s.values[i] };
+        if (!map.dispatch(f, m)) continue;
+
+        std::vector<Event> raised;
+        for (size_t i = 0; i < m.count; ++i)
+        {
+            const PointRoute& r = map.route(m.values[i].route);
+            size_t slot = map.index(s.dev, r) + (r.kind == PointKind::Counter ? map.points(PointKind::Analog, devices) : 0);
+
+            // same rule as Dnp3Publisher: |delta| > deadband, or every frame
+            double v = m.values[i].value;
+            bool changed = std::isnan(last[slot]) || (std::fabs(v - last[slot]) > r.deadband && v != last[slot]);
+            if (!r.every && !changed) continue;
+            last[slot] = v;
+            if (r.event_class == 0) continue;
+
+            Event e{ r.kind, r.event_var };
+            out.events++;
+            out.events_by_class[r.event_class]++;
+            if (polls.empty()) raised.push_back(e);
+            else pending[r.event_class].push_back(e);
+        }
+
+        if (!raised.empty()) out.bytes += wire_bytes(APP_HEADER + event_bytes(raised)) + CONFIRM;
+    }
+    return out;
+}
+
+static void print_row(const char* mode, const char* map, const Totals& t, double hours)
+{
+    printf("%-12s %-7s %10.0f %8.0f %8.0f %8.0f %12.0f %9.1f\n", mode, map, t.events / hours,
+           t.events_by_class[1] / hours, t.events_by_class[2] / hours, t.events_by_class[3] / hours,
+           t.bytes / hours, t.bytes / hours / 3600.0);
+}
+
+int main(int argc, char** argv)
+{
+    double hours = argc > 1 ? atof(argv[1]) : 24.0;
+    const char* path = argc > 2 ? argv[2] : "pointmap.conf";
+    size_t devices = argc > 3 ? strtoul(argv[3], nullptr, 10) : 16;
+
+    PointMap before;
+    PointMap after;
+    std::string error;
+    if (!before.parse(BEFORE_MAP, "before map", error) || !after.load(path, error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    std::vector<SimFrame> frames = simulate(hours, 1);
+    printf("[BENCH] %.0f h, %zu frames, %zu-device database, map %s\n", hours, frames.size(), devices, path);
+    printf("%-12s %-7s %10s %8s %8s %8s %12s %9s\n", "mode", "map", "events/h", "class1", "class2", "class3",
+           "bytes/h", "B/s");
+
+    Totals ub = replay(before, frames, devices, {});
+    Totals ua = replay(after, frames, devices, {});
+    Totals pb = replay(before, frames, devices, { { 2.0, 0xF } });
+    Totals pa = replay(after, frames, devices, { { 2.0, 0x2 }, { 30.0, 0xC }, { 300.0, 0xF } });
+
+    print_row("unsolicited", "before", ub, hours);
+    print_row("unsolicited", "after", ua, hours);
+    print_row("poll", "before", pb, hours);
+    print_row("poll", "after", pa, hours);
+
+    printf("[BENCH] unsolicited %.1f%% of before, poll %.1f%% of before\n",
+           100.0 * ua.bytes / std::max<uint64_t>(ub.bytes, 1), 100.0 * pa.bytes / std::max<uint64_t>(pb.bytes, 1));
+    return 0;
+}
@@ -0,0 +1,104 @@
+/* -------------------- HISTORIAN BENCHMARK --------------------
+ * Appends synthetic ENV samples for a set of devices into a scratch
+ * historian directory, forcing several segment rotations, then runs range
+ * queries for one point. Reports append cost per sample and query scan
+ * rate, and exits non-zero if a query returns the wrong number of samples
+ * or disk use is not bounded.
+ *
+ *   ./bench_historian [samples] [devices] [dir]
+ */
+
+#include "historian.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <dirent.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static void clear_dir(const std::string& dir)
+{
+    if (DIR* d = opendir(dir.c_str()))
+    {
+        while (dirent* e = readdir(d))
+        {
+            if (e->d_name[0] != '.') unlink((dir + "/" + e->d_name).c_str());
+        }
+        closedir(d);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t samples = argc > 1 ? strtoull(argv[1], nullptr, 10) : 4000000;
+    uint16_t devices = argc > 2 ? static_cast<uint16_t>(atoi(argv[2])) : 16;
+    std::string dir  = argc > 3 ? argv[3] : "/tmp/bench_historian";
+
+    HistorianConfig config;
+    config.dir = dir;
+    config.records_per_segment = 1u << 19;
+    config.max_segments = 4;
+    uint64_t per_segment = config.records_per_segment;
+    uint64_t segments = (samples + per_segment - 1) / per_segment;
+    uint64_t first_kept = segments > config.max_segments ? (segments - config.max_segments) * per_segment : 0;
+
+    clear_dir(dir);
+    bool ok = true;
+    {
+        Historian h(config);
+        if (!h.open()) return 1;
+
+        // every device reports TEMP and HUM once per simulated 3 s tick
+        const uint64_t t0 = 1700000000000ull;
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < samples; ++i)
+        {
+            uint64_t tick = i / (2u * devices);
+            uint16_t dev = static_cast<uint16_t>((i / 2) % devices);
+            uint16_t point = static_cast<uint16_t>(i % 2);
+            h.append(dev, point, t0 + tick * 3000, 20.0f + (i % 100) * 0.1f, 0x01);
+        }
+        double append_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / samples;
+
+        // samples of device 0 / point 0 in the segments still on disk
+        uint64_t first_tick = (first_kept + 2u * devices - 1) / (2u * devices);
+        uint64_t last_tick  = (samples - 1) / (2u * devices);
+        uint64_t expect_all = 0;
+        for (uint64_t tick = first_tick; tick <= last_tick; ++tick)
+            if (tick * 2u * devices < samples) ++expect_all;
+
+        start = Clock::now();
+        size_t got_all = h.query(0, 0, 0, UINT64_MAX, [](const HistorySample&) {});
+        double full_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        // last hour only: segments entirely older than the range are skipped
+        uint64_t hour_from = t0 + last_tick * 3000 - 3600 * 1000;
+        start = Clock::now();
+        size_t got_hour = h.query(0, 0, hour_from, UINT64_MAX).size();
+        double hour_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        printf("appended %llu samples in %zu segments (kept %llu)\n",
+               static_cast<unsigned long long>(samples), h.segments(),
+               static_cast<unsigned long long>(samples - first_kept));
+        printf("append:      %8.1f ns/sample\n", append_ns);
+        printf("query all:   %8.2f ms, %zu samples\n", full_ms, got_all);
+        printf("query 1 h:   %8.2f ms, %zu samples\n", hour_ms, got_hour);
+
+        if (h.segments() > config.max_segments) ok = false;
+        uint64_t expect_hour = std::min<uint64_t>(expect_all, 1201);
+        if (got_all != expect_all || got_hour != expect_hour)
+        {
+            printf("QUERY MISMATCH (expected %llu and %llu)\n",
+                   static_cast<unsigned long long>(expect_all),
+                   static_cast<unsigned long long>(expect_hour));
+            ok = false;
+        }
+    }
+    clear_dir(dir);
+    rmdir(dir.c_str());
+    return ok ? 0 : 1;
+}
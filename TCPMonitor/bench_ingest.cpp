@@ -0,0 +1,347 @@
+/* -------------------- INGEST BENCHMARK --------------------
+ * Compares the original blocking accept-read-close loop with the epoll
+ * IngestServer on loopback. By default each client thread behaves like the
+ * original firmware (one connect/send/close per sample); the last case keeps
+ * one session open per client and streams '\n'-framed samples over it.
+ * The udp case sends every sample as its own datagram with a SEQ= number
+ * to the IngestServer UDP socket and reports loss and recvmmsg batching.
+ *
+ *   ./bench_ingest [clients] [frames_per_client] [cases]
+ *
+ * cases is a comma-separated subset of legacy,epoll,persist,udp (default all).
+ */
+
+#include "ingest_server.h"
+#include "seq_tracker.h"
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+/* -------------------- APPLY SIDE -------------------- */
+
+struct Results
+{
+    std::mutex mutex;
+    std::vector<int64_t> accept_to_apply;
+    std::vector<int64_t> client_to_apply;
+    std::atomic<uint64_t> applied{0};
+};
+
+// Same shape of work as the gateway: header sscanf + state update under a lock
+static void apply_frame(Results& r, const char* data, size_t len, Clock::time_point accepted)
+{
+    char buf[256]{};
+    memcpy(buf, data, std::min(len, sizeof(buf) - 1));
+
+    int dev = -1;
+    char type[16]{};
+    long long t0 = 0;
+    if (sscanf(buf, "DEV=%d,TYPE=%15[^,],TEMP=%*f,HUM=%*f,T0=%lld", &dev, type, &t0) != 3)
+        return;
+
+    int64_t now = now_ns();
+    int64_t since_accept = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - accepted).count();
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.accept_to_apply.push_back(since_accept);
+    r.client_to_apply.push_back(now - t0);
+    r.applied.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* -------------------- SERVERS -------------------- */
+
+// The pre-epoll gateway loop, kept verbatim in behaviour
+static int legacy_listen(uint16_t port)
+{
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int opt = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    bind(server, (sockaddr*)&addr, sizeof(addr));
+    listen(server, 10);
+    return server;
+}
+
+static void legacy_loop(int server, Results& r)
+{
+    while (true)
+    {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) return;   // shutdown() from the bench thread
+        Clock::time_point accepted = Clock::now();
+
+        char buf[256]{};
+        int n = read(client, buf, sizeof(buf)-1);
+        close(client);
+
+        if (n <= 0) continue;
+        apply_frame(r, buf, static_cast<size_t>(n), accepted);
+    }
+}
+
+/* -------------------- CLIENTS -------------------- */
+
+static int format_sample(char* msg, size_t cap, int dev)
+{
+    return snprintf(msg, cap, "DEV=%d,TYPE=ENV,TEMP=%.1f,HUM=%.1f,T0=%lld\n",
+                    dev, 21.5, 40.0, (long long)now_ns());
+}
+
+static void persistent_client(const sockaddr_in& dest, int dev, int frames,
+                              std::atomic<uint64_t>& errors)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0 || connect(sock, (const sockaddr*)&dest, sizeof(dest)) != 0)
+    {
+        errors.fetch_add(frames);
+        if (sock >= 0) close(sock);
+        return;
+    }
+
+    char msg[96];
+    for (int i = 0; i < frames; ++i)
+    {
+        int len = format_sample(msg, sizeof(msg), dev);
+        if (send(sock, msg, len, 0) != len) errors.fetch_add(1);
+    }
+    close(sock);
+}
+
+static void udp_client(const sockaddr_in& dest, int dev, int frames,
+                       std::atomic<uint64_t>& errors)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        errors.fetch_add(frames);
+        return;
+    }
+
+    char msg[128];
+    for (int i = 0; i < frames; ++i)
+    {
+        int len = snprintf(msg, sizeof(msg), "DEV=%d,TYPE=ENV,TEMP=%.1f,HUM=%.1f,T0=%lld,SEQ=%d\n",
+                           dev, 21.5, 40.0, (long long)now_ns(), i);
+        if (sendto(sock, msg, len, 0, (const sockaddr*)&dest, sizeof(dest)) != len)
+            errors.fetch_add(1);
+    }
+    close(sock);
+}
+
+static void client_thread(uint16_t port, int dev, int frames, bool persistent,
+                          std::atomic<uint64_t>& errors)
+{
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr);
+
+    if (persistent)
+    {
+        persistent_client(dest, dev, frames, errors);
+        return;
+    }
+
+    for (int i = 0; i < frames; ++i)
+    {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock < 0) { errors.fetch_add(1); continue; }
+
+        char msg[96];
+        long long t0 = now_ns();
+        if (connect(sock, (sockaddr*)&dest, sizeof(dest)) == 0)
+        {
+            int len = snprintf(msg, sizeof(msg),
+                               "DEV=%d,TYPE=ENV,TEMP=%.1f,HUM=%.1f,T0=%lld\n",
+                               dev, 21.5, 40.0, t0);
+            if (send(sock, msg, len, 0) != len) errors.fetch_add(1);
+        }
+        else
+        {
+            errors.fetch_add(1);
+        }
+        close(sock);
+    }
+}
+
+/* -------------------- REPORT --------------------
+ * client->apply starts at the client's first syscall for the sample:
+ * connect() in per-sample mode, send() on a persistent session.
+ */
+
+static double pct_us(std::vector<int64_t>& v, double p)
+{
+    if (v.empty()) return 0.0;
+    size_t i = std::min(v.size() - 1, static_cast<size_t>(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i] / 1000.0;
+}
+
+static void run_case(const char* name, uint16_t port, bool use_epoll, bool persistent,
+                     int clients, int frames)
+{
+    Results r;
+    std::atomic<uint64_t> errors{0};
+    uint64_t expected = static_cast<uint64_t>(clients) * frames;
+
+    std::thread server_thread;
+    IngestServer epoll_server(port, [&](const IngestFrame& f) {
+        apply_frame(r, f.data, f.len, f.accepted);
+    });
+    int legacy_fd = -1;
+
+    if (use_epoll)
+    {
+        if (!epoll_server.open()) return;
+        server_thread = std::thread([&] { epoll_server.run(); });
+    }
+    else
+    {
+        legacy_fd = legacy_listen(port);
+        server_thread = std::thread(legacy_loop, legacy_fd, std::ref(r));
+    }
+
+    auto start = Clock::now();
+
+    std::vector<std::thread> pool;
+    for (int c = 0; c < clients; ++c)
+        pool.emplace_back(client_thread, port, c, frames, persistent, std::ref(errors));
+    for (auto& t : pool) t.join();
+
+    // let the server drain whatever is still in flight
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (r.applied.load() + errors.load() < expected && Clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (use_epoll)
+    {
+        epoll_server.stop();
+    }
+    else
+    {
+        shutdown(legacy_fd, SHUT_RDWR);
+        close(legacy_fd);
+    }
+    server_thread.join();
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    printf("%-8s frames=%llu/%llu errors=%llu  %.0f frames/s\n",
+           name,
+           (unsigned long long)r.applied.load(), (unsigned long long)expected,
+           (unsigned long long)errors.load(),
+           r.applied.load() / secs);
+    if (!persistent)
+    {
+        printf("         accept->apply  p50=%.1fus p99=%.1fus\n",
+               pct_us(r.accept_to_apply, 0.50), pct_us(r.accept_to_apply, 0.99));
+    }
+    printf("         client->apply  p50=%.1fus p99=%.1fus max=%.1fus\n",
+           pct_us(r.client_to_apply, 0.50), pct_us(r.client_to_apply, 0.99),
+           pct_us(r.client_to_apply, 1.0));
+}
+
+static void run_udp_case(const char* name, uint16_t port, int clients, int frames)
+{
+    Results r;
+    SeqTracker seq;
+    Clock::time_point last_apply;   // server thread only until joined
+    std::atomic<uint64_t> errors{0};
+    uint64_t expected = static_cast<uint64_t>(clients) * frames;
+
+    IngestServer server(port, [&](const IngestFrame& f) {
+        const char* s = static_cast<const char*>(memmem(f.data, f.len, "SEQ=", 4));
+        int dev = atoi(static_cast<const char*>(memchr(f.data, '=', f.len)) + 1);
+        if (s && !seq.observe(dev, static_cast<uint32_t>(atol(s + 4)))) return;
+        apply_frame(r, f.data, f.len, f.accepted);
+        last_apply = Clock::now();
+    });
+    if (!server.open() || !server.open_udp(port)) return;
+    std::thread server_thread([&] { server.run(); });
+
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &dest.sin_addr);
+
+    auto start = Clock::now();
+    std::vector<std::thread> pool;
+    for (int c = 0; c < clients; ++c)
+        pool.emplace_back(udp_client, std::cref(dest), c, frames, std::ref(errors));
+    for (auto& t : pool) t.join();
+
+    // datagrams still queued are drained quickly; stop once nothing moves
+    uint64_t last = ~0ull;
+    while (r.applied.load() != last)
+    {
+        last = r.applied.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    server.stop();
+    server_thread.join();
+    double secs = std::chrono::duration<double>(last_apply - start).count();
+
+    uint64_t lost = 0, dup = 0;
+    for (int c = 0; c < clients && c < static_cast<int>(MAX_DEVICES); ++c)
+    {
+        lost += seq.counters(c).lost.load();
+        dup += seq.counters(c).duplicates.load();
+    }
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    printf("%-8s frames=%llu/%llu errors=%llu  %.0f frames/s\n",
+           name,
+           (unsigned long long)r.applied.load(), (unsigned long long)expected,
+           (unsigned long long)errors.load(),
+           r.applied.load() / secs);
+    printf("         undelivered=%llu (seq gaps=%llu, tail losses have no later seq) dup=%llu  datagrams/recvmmsg=%.1f\n",
+           (unsigned long long)(expected - r.applied.load()),
+           (unsigned long long)lost, (unsigned long long)dup,
+           server.udp_batches() ? double(server.udp_datagrams()) / server.udp_batches() : 0.0);
+    printf("         client->apply  p50=%.1fus p99=%.1fus max=%.1fus\n",
+           pct_us(r.client_to_apply, 0.50), pct_us(r.client_to_apply, 0.99),
+           pct_us(r.client_to_apply, 1.0));
+}
+
+int main(int argc, char** argv)
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 64;
+    int frames  = argc > 2 ? atoi(argv[2]) : 200;
+
+    printf("[BENCH] %d clients x %d frames\n", clients, frames);
+
+    const char* cases = argc > 3 ? argv[3] : "legacy,epoll,persist,udp";
+    auto want = [&](const char* name) { return strstr(cases, name) != nullptr; };
+
+    if (want("legacy"))  run_case("legacy",  19100, false, false, clients, frames);
+    if (want("epoll"))   run_case("epoll",   19101, true,  false, clients, frames);
+    if (want("persist")) run_case("persist", 19102, true,  true,  clients, frames);
+    if (want("udp"))     run_udp_case("udp", 19103, clients, frames);
+}
@@ -0,0 +1,463 @@
+/* -------------------- FIRMWARE LINK BENCHMARK --------------------
+ * Runs the firmware's shared gateway link (SCADA_COMPS/components/
+ * scada_link) on Linux against a stub socket layer.
+ *
+ * 1. Simulated time, one thread: an encoder-like sender pushes bursts of
+ *    frames while the stub gateway breaks the session every few writes
+ *    (every other time mid-frame, otherwise losing what it had not read
+ *    yet) and refuses connects for a while. Counts writes and estimated
+ *    radio bytes against the old one-send-per-frame senders. The stub
+ *    frames and dedupes like the gateway (IngestServer delivers the
+ *    unterminated tail of a session that never sent a '\n', SeqTracker
+ *    drops repeated SEQ=), and the run checks every queued frame got there
+ *    once, in order, and nothing else did.
+ * 2. The same with the gateway gone for 30 s mid-run, longer than the ring
+ *    holds: RAM only (the oldest frames are dropped) and with a spill store
+ *    standing in for NVS (nothing lost, the backlog drains on reconnect).
+ *    Then with a store too small for the outage and a keypad frame without
+ *    SEQ= in every burst: the store overflows and resends all it holds,
+ *    and no unsequenced frame may be applied twice.
+ * 3. Short writes: every break comes after a write cut short, and sessions
+ *    last one to three writes, so the first write of a session is cut too.
+ * 4. Real threads: a sender pushes every 2 ms while the link task's
+ *    writes take 20 ms (a slow radio); push() time is what a sensor task
+ *    now waits, where the old blocking send() waited the whole write.
+ *    Then with the gateway down and a spill store whose writes take 5 ms
+ *    (an NVS blob and commit): pushes still never wait on the store.
+ *
+ *   ./bench_link [bursts] [frames_per_burst] [burst_ms]
+ */
+
+#include <scada_link.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// IPv4 + TCP + 802.11 MAC/LLC headers per data segment, ACKs not counted
+static constexpr size_t SEGMENT_OVERHEAD = 40 + 34;
+
+// frames still in the gateway's socket buffer when a session breaks
+// without a cut write (a cut one means the bytes before the cut got there)
+static constexpr size_t UNREAD_LINES = 3;
+
+/* -------------------- SIMULATED GATEWAY -------------------- */
+
+struct SimGateway
+{
+    uint32_t now = 0;
+
+    int break_every = 50;           // writes per session before it breaks
+    bool short_writes = false;      // every break cuts a write, sessions of 1-3 writes
+    uint32_t outage_ms = 200;       // connects refused this long after a break
+    uint32_t refused_until = 0;
+    uint32_t down_from = 0, down_until = 0;   // one long outage
+
+    int next_sock = 3;
+    int writes_in_session = 0;
+    int breaks = 0;
+    bool broken = false;            // the open session failed a write
+    bool cut = false;               // ... after writing part of it
+    std::string session;            // bytes of the open session
+    std::vector<std::string> pushed;   // every frame queued, by SEQ, without '\n'
+    std::vector<uint32_t> received; // SEQ of every frame kept, in order
+    std::vector<bool> seen;
+    std::vector<std::string> plain;    // frames queued without SEQ=, by their N= tag
+    std::vector<bool> applied;
+    size_t repeated = 0;            // frames without SEQ= applied twice, nothing dedupes them
+    size_t duplicates = 0;
+    size_t truncated = 0;           // cut tails dropped at close
+    size_t bogus = 0;               // frames applied that were never queued (cut ones)
+    size_t late = 0;
+    size_t unread = 0;
+    size_t writes = 0;
+    size_t payload = 0;
+
+    void end_session()
+    {
+        // the last few lines of a broken session may never leave the socket
+        // buffer; then the gateway's IngestServer rules: empty lines are
+        // skipped, and an unterminated tail is a frame of its own unless the
+        // session sent a '\n' before it
+        size_t start = 0, nl;
+        std::vector<std::string> lines;
+        while ((nl = session.find('\n', start)) != std::string::npos)
+        {
+            lines.push_back(session.substr(start, nl - start));
+            start = nl + 1;
+        }
+        std::string tail = session.substr(start);
+        bool framed = !lines.empty();
+        session.clear();
+
+        size_t lost = broken && !cut ? std::min(lines.size(), UNREAD_LINES) : 0;
+        broken = cut = false;
+        unread += lost;
+        lines.resize(lines.size() - lost);
+        if (!tail.empty() && !lost)
+        {
+            if (framed) truncated++;
+            else lines.push_back(tail);
+        }
+
+        for (const std::string& line : lines)
+        {
+            if (line.empty()) continue;
+            size_t at = line.find("SEQ=");
+            if (at == std::string::npos && (at = line.find(",N=")) != std::string::npos)
+            {
+                uint32_t n = static_cast<uint32_t>(strtoul(line.c_str() + at + 3, nullptr, 10));
+                if (n >= plain.size() || line != plain[n]) bogus++;
+                else if (applied[n]) repeated++;
+                else applied[n] = true;
+                continue;
+            }
+            uint32_t seq = at == std::string::npos ? UINT32_MAX
+                                                   : static_cast<uint32_t>(strtoul(line.c_str() + at + 4, nullptr, 10));
+            if (seq >= pushed.size() || line != pushed[seq])
+            {
+                bogus++;
+                continue;
+            }
+            if (seq >= seen.size()) seen.resize(seq + 1);
+            if (seen[seq])
+            {
+                duplicates++;
+                continue;
+            }
+            seen[seq] = true;
+            if (!received.empty() && seq < received.back()) late++;
+            received.push_back(seq);
+        }
+    }
+
+    bool down() const
+    {
+        return static_cast<int32_t>(now - refused_until) < 0 || (now >= down_from && now < down_until);
+    }
+};
+
+static int sim_open(void* ctx)
+{
+    auto* g = static_cast<SimGateway*>(ctx);
+    if (g->down()) return -1;
+    g->writes_in_session = 0;
+    return g->next_sock++;
+}
+
+static int sim_write(void* ctx, int, const void* buf, size_t len)
+{
+    auto* g = static_cast<SimGateway*>(ctx);
+    g->writes++;
+    g->payload += len;
+
+    int session_writes = g->short_writes ? 1 + g->breaks % 3 : g->break_every;
+    if (++g->writes_in_session < session_writes && !g->down())
+    {
+        g->session.append(static_cast<const char*>(buf), len);
+        return static_cast<int>(len);
+    }
+
+    // break: every other time (or every time) after part of the batch went out
+    g->broken = true;
+    g->refused_until = g->now + g->outage_ms;
+    if (++g->breaks % 2 || g->short_writes)
+    {
+        g->cut = true;
+        size_t part = len / 2 + 1;
+        g->session.append(static_cast<const char*>(buf), part);
+        return static_cast<int>(part);
+    }
+    return -1;
+}
+
+static void sim_close(void* ctx, int)
+{
+    static_cast<SimGateway*>(ctx)->end_session();
+}
+
+static uint32_t sim_now(void* ctx)
+{
+    return static_cast<SimGateway*>(ctx)->now;
+}
+
+/* -------------------- SPILL STORE (NVS stand-in) -------------------- */
+
+struct SimSpill
+{
+    SimGateway gw;                  // first, the io callbacks cast ctx to it
+    std::deque<std::string> frames;
+    size_t capacity = 0;
+    size_t most = 0;
+    size_t overflow = 0;            // dropped by the full store
+};
+
+static bool spill_put(void* ctx, const void* frame, size_t len)
+{
+    auto* s = static_cast<SimSpill*>(ctx);
+    if (s->frames.size() >= s->capacity)
+    {
+        s->frames.pop_front();
+        s->overflow++;
+    }
+    s->frames.emplace_back(static_cast<const char*>(frame), len);
+    s->most = std::max(s->most, s->frames.size());
+    return true;
+}
+
+static size_t spill_read(void* ctx, size_t skip, void* buf, size_t cap, size_t* frames)
+{
+    auto* s = static_cast<SimSpill*>(ctx);
+    size_t bytes = 0;
+    *frames = 0;
+    for (size_t i = skip; i < s->frames.size(); ++i)
+    {
+        const std::string& f = s->frames[i];
+        if (bytes + f.size() > cap) break;
+        memcpy(static_cast<char*>(buf) + bytes, f.data(), f.size());
+        bytes += f.size();
+        (*frames)++;
+    }
+    return bytes;
+}
+
+static void spill_drop(void* ctx, size_t frames)
+{
+    auto* s = static_cast<SimSpill*>(ctx);
+    s->frames.erase(s->frames.begin(), s->frames.begin() + static_cast<long>(std::min(frames, s->frames.size())));
+}
+
+/* -------------------- RUN -------------------- */
+
+struct SimRun
+{
+    const char* name;
+    int bursts, per_burst;
+    uint32_t burst_ms;
+    uint32_t down_ms;               // long outage in the middle, 0 = none
+    size_t spill_frames;            // 0 = RAM only
+    bool short_writes;
+    bool keypad;                    // a frame without SEQ= in every burst too
+};
+
+static int run_simulated(const SimRun& run)
+{
+    SimSpill sim;
+    SimGateway& gw = sim.gw;
+    if (run.short_writes)
+    {
+        gw.short_writes = true;
+        gw.outage_ms = 20;
+    }
+    uint32_t end = static_cast<uint32_t>(run.bursts) * run.burst_ms;
+    if (run.down_ms)
+    {
+        gw.down_from = end / 2;
+        gw.down_until = end / 2 + run.down_ms;
+    }
+
+    scada_link_io io = {};
+    io.ctx = &sim;
+    io.open = sim_open;
+    io.write = sim_write;
+    io.close = sim_close;
+    io.now_ms = sim_now;
+    if (run.spill_frames)
+    {
+        sim.capacity = run.spill_frames;
+        io.spill_put = spill_put;
+        io.spill_read = spill_read;
+        io.spill_drop = spill_drop;
+    }
+
+    scada_link_config config = SCADA_LINK_CONFIG_DEFAULT;
+    static scada_link link;
+    scada_link_init(&link, &config, &io);
+
+    size_t frame_bytes = 0;
+    uint32_t seq = 0;
+    uint32_t poll_at = 0;
+    uint32_t drained_at = 0;
+
+    for (gw.now = 0; gw.now < end || scada_link_queued(&link) || link.spill_pending; ++gw.now)
+    {
+        bool woken = false;
+        if (gw.now < end && gw.now % run.burst_ms == 0)
+        {
+            for (int i = 0; i < run.per_burst; ++i)
+            {
+                char frame[96];
+                int len = snprintf(frame, sizeof(frame), "DEV=3,TYPE=ROTARY,L=%d,R=%d,SEQ=%u,TS=%u\n",
+                                   i % 2, (i + 1) % 2, seq++, gw.now);
+                frame_bytes += static_cast<size_t>(len);
+                gw.pushed.emplace_back(frame, static_cast<size_t>(len) - 1);
+                scada_link_push(&link, frame, static_cast<size_t>(len), SCADA_LINK_SEQUENCED);
+            }
+            if (run.keypad)
+            {
+                // like a PASSWORD_* frame: applied every time it arrives. N= only
+                // tells the stub which one it is
+                char frame[64];
+                uint32_t n = static_cast<uint32_t>(gw.plain.size());
+                int len = snprintf(frame, sizeof(frame), "DEV=4,TYPE=KEYPAD,KEY=%c,N=%u\n", '0' + n % 10, n);
+                frame_bytes += static_cast<size_t>(len);
+                gw.plain.emplace_back(frame, static_cast<size_t>(len) - 1);
+                gw.applied.push_back(false);
+                scada_link_push(&link, frame, static_cast<size_t>(len), 0);
+            }
+            woken = true;
+        }
+
+        if (woken || gw.now >= poll_at)
+        {
+            uint32_t wait = 0;
+            while ((wait = scada_link_poll(&link)) == 0) {}
+            poll_at = wait == SCADA_LINK_IDLE ? UINT32_MAX : gw.now + wait;
+        }
+        if (run.down_ms && !drained_at && gw.now >= gw.down_until && !scada_link_queued(&link) && !link.spill_pending)
+            drained_at = gw.now;
+        if (gw.now > end + 600000) break;   // never drained
+    }
+    scada_link_disconnect(&link);
+
+    const scada_link_stats& st = link.stats;
+    size_t pushes = seq + gw.plain.size();
+    size_t old_air = frame_bytes + pushes * SEGMENT_OVERHEAD;
+    size_t new_air = gw.payload + gw.writes * SEGMENT_OVERHEAD;
+    size_t lost = seq - gw.received.size();
+
+    printf("[BENCH] %s: %d bursts x %d frames every %u ms, ", run.name, run.bursts, run.per_burst, run.burst_ms);
+    if (gw.short_writes) printf("sessions of 1-3 writes, the last cut short");
+    else printf("session breaks every %d writes", gw.break_every);
+    printf(", %u ms outages", gw.outage_ms);
+    if (run.down_ms) printf(", gateway down %u s", run.down_ms / 1000);
+    if (run.keypad) printf(", plus a frame without SEQ=");
+    printf("\n");
+    printf("  per-frame send   writes=%zu  air~%zu B\n", pushes, old_air);
+    printf("  scada_link       writes=%zu  air~%zu B (%.1f%%)  frames/write=%.2f\n", gw.writes, new_air,
+           100.0 * new_air / old_air, double(st.frames_sent + st.frames_replayed) / std::max<size_t>(1, gw.writes));
+    printf("  connects=%u connect_failures=%u write_failures=%u\n", st.connects, st.connect_failures, st.write_failures);
+    printf("  cut tails dropped=%zu unread at breaks=%zu replayed=%u duplicates dropped=%zu spilled=%u (most held %zu) "
+           "dropped=%zu\n", gw.truncated, gw.unread, st.frames_replayed, gw.duplicates, st.frames_spilled, sim.most, st.frames_dropped + sim.overflow);
+    if (drained_at) printf("  backlog drained %u ms after the gateway came back\n", drained_at - gw.down_until);
+    if (run.keypad)
+        printf("  without SEQ=: %zu applied of %zu queued, %zu applied twice\n",
+               static_cast<size_t>(std::count(gw.applied.begin(), gw.applied.end(), true)), gw.plain.size(), gw.repeated);
+
+    // a dropped frame may still have arrived (written before a break); one
+    // without SEQ= may be lost but never applied twice
+    bool ok = gw.late == 0 && gw.bogus == 0 && gw.repeated == 0 && lost <= st.frames_dropped + sim.overflow;
+    if (!ok)
+        printf("  FAIL: %u frames queued, %zu received, %zu lost, %zu out of order, %zu bogus, %zu applied twice\n", seq,
+               gw.received.size(), lost, gw.late, gw.bogus, gw.repeated);
+    else if (lost)
+        printf("  %zu frames lost, all to a full queue; the rest received once, in order\n", lost);
+    else
+        printf("  every queued frame received once, in order\n");
+    return ok ? 0 : 1;
+}
+
+/* -------------------- SENDER JITTER -------------------- */
+
+static std::mutex g_queue_mutex;
+static std::atomic<bool> g_wake{false};
+
+static void run_threaded(bool spill)
+{
+    scada_link_io io = {};
+    io.open = [](void*) { return 3; };
+    io.write = [](void*, int, const void*, size_t len) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return static_cast<int>(len);
+    };
+    io.close = [](void*, int) {};
+    io.now_ms = [](void*) {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    };
+    io.lock = [](void*) { g_queue_mutex.lock(); };
+    io.unlock = [](void*) { g_queue_mutex.unlock(); };
+    io.wake = [](void*) { g_wake.store(true); };
+    if (spill)
+    {
+        io.open = [](void*) { return -1; };   // gateway down
+        io.spill_put = [](void*, const void*, size_t) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            return true;
+        };
+        io.spill_read = [](void*, size_t, void*, size_t, size_t* frames) -> size_t {
+            *frames = 0;
+            return 0;
+        };
+        io.spill_drop = [](void*, size_t) {};
+    }
+
+    static scada_link link;
+    scada_link_init(&link, nullptr, &io);
+
+    std::atomic<bool> running{true};
+    std::thread task([&] {
+        // with the gateway down nothing drains, stop with the sender
+        while (running.load() || (!spill && scada_link_queued(&link)))
+        {
+            uint32_t wait = scada_link_poll(&link);
+            if (wait && !g_wake.exchange(false))
+                std::this_thread::sleep_for(std::chrono::milliseconds(std::min<uint32_t>(wait, 1)));
+        }
+    });
+
+    std::vector<int64_t> cost;
+    const char frame[] = "DEV=2,TYPE=SENSOR,GPIO=18,STATE=1,SEQ=0,TS=0\n";
+    for (int i = 0; i < 1000; ++i)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        scada_link_push(&link, frame, sizeof(frame) - 1, SCADA_LINK_SEQUENCED);
+        cost.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    running.store(false);
+    task.join();
+
+    std::sort(cost.begin(), cost.end());
+    if (spill) printf("[BENCH] 1000 pushes every 2 ms, gateway down, 5 ms per spill write\n");
+    else printf("[BENCH] 1000 pushes every 2 ms, 20 ms per write\n");
+    printf("  push p50=%.1f us p99=%.1f us max=%.1f us (a blocking %s waits ~%d us)\n",
+           cost[cost.size() / 2] / 1000.0, cost[cost.size() * 99 / 100] / 1000.0, cost.back() / 1000.0,
+           spill ? "spill" : "send", spill ? 5000 : 20000);
+    if (spill)
+        printf("  spilled=%u dropped=%u (the store takes 200 frames/s, the sender pushes 500)\n",
+               link.stats.frames_spilled, link.stats.frames_dropped);
+    else
+        printf("  writes=%u frames/write=%.1f dropped=%u\n", link.stats.writes,
+               double(link.stats.frames_sent) / std::max<uint32_t>(1, link.stats.writes), link.stats.frames_dropped);
+}
+
+int main(int argc, char** argv)
+{
+    int bursts = argc > 1 ? atoi(argv[1]) : 2000;
+    int per_burst = argc > 2 ? atoi(argv[2]) : 4;
+    uint32_t burst_ms = argc > 3 ? static_cast<uint32_t>(atoi(argv[3])) : 40;
+
+    bursts = std::max(1, bursts);
+    per_burst = std::max(1, per_burst);
+    burst_ms = std::max<uint32_t>(1, burst_ms);
+
+    int rc = run_simulated({"flaky", bursts, per_burst, burst_ms, 0, 0, false, false});
+    rc |= run_simulated({"outage, RAM only", bursts, per_burst, burst_ms, 30000, 0, false, false});
+    rc |= run_simulated({"outage, spill", bursts, per_burst, burst_ms, 30000, 4096, false, false});
+    // the store overflows and sends all it holds again
+    rc |= run_simulated({"outage, small spill, keypad", bursts, per_burst, burst_ms, 30000, 1024, false, true});
+    // every break costs a backoff here, so a slower sender keeps up
+    rc |= run_simulated({"short writes", bursts, per_burst, burst_ms * 5, 0, 0, true, false});
+    run_threaded(false);
+    run_threaded(true);
+    return rc;
+}
@@ -0,0 +1,100 @@
+/* -------------------- LOG BENCHMARK --------------------
+ * Producer threads log [ENV] readings as fast as they can, first the old
+ * way (formatted write to the sink under one mutex, like std::cout in the
+ * ingest path) and then through AsyncLog. Reports the time each producer
+ * spends per delivered line and checks that every line AsyncLog accepted
+ * was written out. The ring holds the whole run, so the timing is of
+ * logging and not of refusing full-ring records; more than 0.1% dropped
+ * fails the run.
+ *
+ *   ./bench_log [producers] [records per producer]
+ */
+
+#include "async_log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+template <class Fn>
+static double run(int producers, int records, Fn log_one)
+{
+    std::vector<std::thread> pool;
+    auto t0 = Clock::now();
+    for (int p = 0; p < producers; ++p)
+    {
+        pool.emplace_back([=] {
+            for (int i = 0; i < records; ++i)
+                log_one(p, static_cast<float>(i % 40), static_cast<float>(i % 100));
+        });
+    }
+    for (auto& t : pool) t.join();
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    return ns / records;   // wall time per call seen by each producer
+}
+
+static long count_lines(FILE* f)
+{
+    rewind(f);
+    long lines = 0;
+    for (int c; (c = fgetc(f)) != EOF; )
+        if (c == '\n') ++lines;
+    return lines;
+}
+
+int main(int argc, char** argv)
+{
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    int records   = argc > 2 ? atoi(argv[2]) : 50000;
+    long total = static_cast<long>(producers) * records;
+
+    FILE* sync_sink = tmpfile();
+    std::mutex sync_mutex;
+    double sync_ns = run(producers, records, [&](int dev, float t, float h) {
+        std::lock_guard<std::mutex> lock(sync_mutex);
+        fprintf(sync_sink, "[ENV] T=%g H=%g DEV=%d\n", t, h, dev);
+        fflush(sync_sink);
+    });
+    long sync_lines = count_lines(sync_sink);
+
+    FILE* async_sink = tmpfile();
+    double async_ns;
+    uint64_t dropped;
+    {
+        AsyncLog log(std::max<size_t>(1 << 16, static_cast<size_t>(total)));
+        log.start(async_sink);
+        async_ns = run(producers, records, [&](int dev, float t, float h) {
+            log.env(dev, t, h);
+        });
+        log.stop();
+        dropped = log.dropped();
+    }
+    // the flusher adds one "[LOG] dropped" line per burst of drops
+    long async_lines = count_lines(async_sink);
+    long expected = total - static_cast<long>(dropped);
+    // a dropped record costs a failed enqueue, not a line: charge the time to what got out
+    async_ns = async_ns * total / std::max<long>(1, expected);
+
+    printf("%-12s %10s %10s %10s\n", "logger", "ns/line", "lines", "dropped");
+    printf("%-12s %10.0f %10ld %10d\n", "sync+mutex", sync_ns, sync_lines, 0);
+    printf("%-12s %10.0f %10ld %10llu\n", "async ring", async_ns, async_lines,
+           static_cast<unsigned long long>(dropped));
+    printf("speedup: %.1fx per line\n", sync_ns / async_ns);
+
+    bool ok = sync_lines == total && async_lines >= expected &&
+              (dropped == 0 ? async_lines == expected : true);
+    if (!ok) printf("LINE COUNT MISMATCH (expected %ld)\n", expected);
+    if (dropped * 1000 > static_cast<uint64_t>(total))
+    {
+        printf("TOO MANY DROPS (%.1f%%, limit 0.1%%)\n", 100.0 * dropped / total);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+/* -------------------- PARSER BENCHMARK --------------------
+ * Times the original sscanf/strcmp cascade against parse_frame() on the
+ * same set of frames and checks that both decode identical values.
+ *
+ *   ./bench_parser [frames.txt] [iterations]
+ *
+ * frames.txt holds one recorded frame per line (e.g. captured with
+ * "nc -lk 9100 > frames.txt"); without it a built-in set matching the
+ * four firmware senders is used.
+ */
+
+#include "frame_parser.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct Decoded
+{
+    bool ok = false;
+    FrameType type = FrameType::Unknown;
+    int dev = -1;
+    float a = 0.0f, b = 0.0f;
+    char key = 0;
+};
+
+// Verbatim from the pre-parser gateway, minus the logging and state writes
+static Decoded legacy_parse(const char* frame)
+{
+    Decoded d;
+    char buf[256]{};
+    strncpy(buf, frame, sizeof(buf) - 1);
+
+    int dev = -1;
+    char type[16]{};
+    if (sscanf(buf, "DEV=%d,TYPE=%15[^,]", &dev, type) != 2) return d;
+    d.dev = dev;
+
+    if (strcmp(type, "ENV") == 0)
+    {
+        float t, h;
+        if (sscanf(buf, "DEV=%*d,TYPE=ENV,TEMP=%f,HUM=%f", &t, &h) == 2)
+        {
+            d = Decoded{ true, FrameType::Env, dev, t, h, 0 };
+        }
+    }
+    else if (strcmp(type, "KEYPAD") == 0)
+    {
+        char key;
+        if (sscanf(buf, "DEV=%*d,TYPE=KEYPAD,KEY=%c", &key) == 1)
+        {
+            d = Decoded{ true, FrameType::Keypad, dev, 0, 0, key };
+        }
+    }
+    else if (strcmp(type, "SENSOR") == 0)
+    {
+        int st;
+        if (sscanf(buf, "DEV=%*d,TYPE=SENSOR,GPIO=%*d,STATE=%d", &st) == 1)
+        {
+            d = Decoded{ true, FrameType::Sensor, dev, (float)st, 0, 0 };
+        }
+    }
+    else if (strcmp(type, "ROTARY") == 0)
+    {
+        int l, r;
+        if (sscanf(buf, "DEV=%*d,TYPE=ROTARY,L=%d,R=%d", &l, &r) == 2)
+        {
+            d = Decoded{ true, FrameType::Rotary, dev, (float)l, (float)r, 0 };
+        }
+    }
+    return d;
+}
+
+static Decoded new_parse(const char* frame, size_t len)
+{
+    Decoded d;
+    Frame f;
+    if (parse_frame(frame, len, f) != ParseStatus::Ok) return d;
+
+    d.ok = true;
+    d.type = f.type;
+    d.dev = f.dev;
+    switch (f.type)
+    {
+    case FrameType::Env:    d.a = f.temp;  d.b = f.hum;   break;
+    case FrameType::Keypad: d.key = f.key;                break;
+    case FrameType::Sensor: d.a = (float)f.state;         break;
+    case FrameType::Rotary: d.a = (float)f.left; d.b = (float)f.right; break;
+    default: break;
+    }
+    return d;
+}
+
+static bool same(const Decoded& x, const Decoded& y)
+{
+    if (x.ok != y.ok) return false;
+    if (!x.ok) return true;
+    return x.type == y.type && x.dev == y.dev && x.key == y.key &&
+           std::fabs(x.a - y.a) < 1e-4f && std::fabs(x.b - y.b) < 1e-4f;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> frames;
+
+    if (argc > 1)
+    {
+        std::ifstream in(argv[1]);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) frames.push_back(line);
+        }
+    }
+    if (frames.empty())
+    {
+        frames = {
+            "DEV=0,TYPE=ENV,TEMP=23.0,HUM=41.0",
+            "DEV=0,TYPE=ENV,TEMP=22.8,HUM=44.5",
+            "DEV=1,TYPE=KEYPAD,KEY=7",
+            "DEV=1,TYPE=KEYPAD,KEY=#",
+            "DEV=2,TYPE=SENSOR,GPIO=18,STATE=1",
+            "DEV=2,TYPE=SENSOR,GPIO=18,STATE=0",
+            "DEV=3,TYPE=ROTARY,L=1,R=0",
+            "DEV=3,TYPE=ROTARY,L=0,R=1",
+        };
+    }
+
+    long iters = argc > 2 ? atol(argv[2]) : 200000;
+
+    size_t mismatches = 0;
+    for (const auto& f : frames)
+    {
+        if (!same(legacy_parse(f.c_str()), new_parse(f.data(), f.size())))
+        {
+            printf("[BENCH] mismatch: %s\n", f.c_str());
+            ++mismatches;
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    volatile int sink = 0;
+
+    auto t0 = Clock::now();
+    for (long i = 0; i < iters; ++i)
+        for (const auto& f : frames) sink += legacy_parse(f.c_str()).dev;
+    auto t1 = Clock::now();
+    for (long i = 0; i < iters; ++i)
+        for (const auto& f : frames) sink += new_parse(f.data(), f.size()).dev;
+    auto t2 = Clock::now();
+
+    double n = static_cast<double>(iters) * frames.size();
+    double legacy_ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+    double parser_ns = std::chrono::duration<double, std::nano>(t2 - t1).count() / n;
+
+    printf("[BENCH] %zu frames x %ld iterations, %zu mismatches\n",
+           frames.size(), iters, mismatches);
+    printf("sscanf       %8.1f ns/frame\n", legacy_ns);
+    printf("parse_frame  %8.1f ns/frame  (%.1fx)\n", parser_ns, legacy_ns / parser_ns);
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+/* -------------------- SHARDED INGEST BENCHMARK --------------------
+ * Measures how ingest throughput scales with the number of SO_REUSEPORT
+ * workers, using the same structure as the gateway: every worker parses
+ * what it receives, applies frames for the devices it owns (dev % workers)
+ * to the device table and hands the rest to the owner through its
+ * ShardQueue, waking it once per epoll round.
+ *
+ * Client threads stream pre-formatted ENV frames for random devices over
+ * persistent sessions as fast as the workers take them. They run on the
+ * same machine, so on a 4-core Pi they compete with the workers for CPU;
+ * for absolute numbers drive a real gateway from another host with loadgen.
+ *
+ *   ./bench_shard [clients] [seconds] [max_workers]
+ *
+ * Runs 1, 2, 4 ... up to max_workers (default 4) and prints frames/s and
+ * the speedup over one worker.
+ */
+
+#include "ingest_server.h"
+#include "frame_parser.h"
+#include "device_table.h"
+#include "shard_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t DEVICES = MAX_DEVICES;
+
+struct Shard
+{
+    size_t index = 0;
+    ShardQueue inbox;
+    std::atomic<IngestServer*> server{nullptr};
+    std::vector<uint8_t> wake_pending;
+    alignas(64) std::atomic<uint64_t> applied{0};
+    std::atomic<uint64_t> handoffs{0};
+};
+
+struct Run
+{
+    std::vector<std::unique_ptr<Shard>> shards;
+    DeviceTable table;
+    std::atomic<size_t> ready{0};
+};
+
+static void drain(Run& run, Shard& shard);
+
+static void apply(Run& run, Shard& shard, const Frame& f)
+{
+    DeviceState d = run.table.load(f.dev);
+    d.values[0] = f.temp;
+    d.values[1] = f.hum;
+    d.type = static_cast<uint8_t>(f.type);
+    d.seen = true;
+    d.last_update = Clock::now();
+    run.table.store(f.dev, d);
+    shard.applied.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void handle(Run& run, Shard& shard, const IngestFrame& in)
+{
+    Frame f;
+    if (parse_frame(in.data, in.len, f) != ParseStatus::Ok) return;
+    if (f.dev < 0 || static_cast<size_t>(f.dev) >= DEVICES) return;
+
+    Shard& owner = *run.shards[f.dev % run.shards.size()];
+    if (&owner == &shard)
+    {
+        apply(run, shard, f);
+        return;
+    }
+
+    // same backpressure as the gateway: never drop, keep our inbox moving
+    f.type_name = frame_type_name(f.type);
+    f.field_count = 0;
+    shard.handoffs.fetch_add(1, std::memory_order_relaxed);
+    ShardFrame sf{ f, MappedFrame{}, in.received, in.received };
+    while (!owner.inbox.push(sf))
+    {
+        IngestServer* s = owner.server.load();
+        if (!s) return;   // owner already stopped at the end of the run
+        s->wake();
+        drain(run, shard);
+        std::this_thread::yield();
+    }
+    shard.wake_pending[owner.index] = 1;
+}
+
+static void drain(Run& run, Shard& shard)
+{
+    ShardFrame sf;
+    while (shard.inbox.pop(sf)) apply(run, shard, sf.frame);
+}
+
+static void worker(Run& run, Shard& shard, uint16_t port)
+{
+    IngestServer server(port, [&](const IngestFrame& f) { handle(run, shard, f); });
+    server.set_reuse_port(true);
+    if (!server.open())
+    {
+        run.ready.fetch_add(1);
+        return;
+    }
+
+    server.set_timer([&] {
+        for (size_t i = 0; i < shard.wake_pending.size(); ++i)
+        {
+            if (!shard.wake_pending[i]) continue;
+            shard.wake_pending[i] = 0;
+            if (IngestServer* s = run.shards[i]->server.load()) s->wake();
+        }
+        return -1;
+    });
+    server.set_wake_handler([&] { drain(run, shard); });
+
+    shard.server.store(&server);
+    run.ready.fetch_add(1);
+    while (run.ready.load() < run.shards.size()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    server.run();
+    shard.server.store(nullptr);
+}
+
+static std::string make_stream(unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string out;
+    char line[96];
+    while (out.size() < 64 * 1024)
+    {
+        int n = snprintf(line, sizeof(line), "DEV=%u,TYPE=ENV,TEMP=%.1f,HUM=%.1f\n",
+                         static_cast<unsigned>(rng() % DEVICES), 15.0 + rng() % 200 / 10.0,
+                         30.0 + rng() % 400 / 10.0);
+        out.append(line, static_cast<size_t>(n));
+    }
+    return out;
+}
+
+static void client(uint16_t port, unsigned seed, const std::atomic<bool>& stop)
+{
+    std::string stream = make_stream(seed);
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        close(sock);
+        return;
+    }
+
+    // the stream only ends on whole lines, so it can be replayed back to back
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        size_t sent = 0;
+        while (sent < stream.size())
+        {
+            ssize_t n = send(sock, stream.data() + sent, stream.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                close(sock);
+                return;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+    close(sock);
+}
+
+static uint64_t total_applied(const Run& run)
+{
+    uint64_t n = 0;
+    for (const auto& s : run.shards) n += s->applied.load();
+    return n;
+}
+
+static double run_case(size_t workers, int clients, double seconds, uint16_t port, double* handoff_pct)
+{
+    Run run;
+    for (size_t i = 0; i < workers; ++i)
+    {
+        auto s = std::make_unique<Shard>();
+        s->index = i;
+        s->wake_pending.assign(workers, 0);
+        run.shards.push_back(std::move(s));
+    }
+
+    std::vector<std::thread> threads;
+    for (auto& s : run.shards) threads.emplace_back(worker, std::ref(run), std::ref(*s), port);
+    while (run.ready.load() < workers) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> senders;
+    for (int c = 0; c < clients; ++c) senders.emplace_back(client, port, 1234u + c, std::cref(stop));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));   // warm up
+    uint64_t a0 = total_applied(run);
+    auto t0 = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    uint64_t a1 = total_applied(run);
+    double elapsed = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    stop.store(true);
+    for (auto& t : senders) t.join();
+    for (auto& s : run.shards)
+        if (IngestServer* srv = s->server.load()) srv->stop();
+    for (auto& t : threads) t.join();
+
+    uint64_t handoffs = 0;
+    for (const auto& s : run.shards) handoffs += s->handoffs.load();
+    uint64_t applied = total_applied(run);
+    *handoff_pct = applied ? 100.0 * handoffs / applied : 0.0;
+
+    return (a1 - a0) / elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 16;
+    double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+    size_t max_workers = argc > 3 ? strtoul(argv[3], nullptr, 10) : 4;
+
+    printf("[BENCH] %d clients, %.1f s per run, %u hardware threads\n", clients, seconds,
+           std::thread::hardware_concurrency());
+    printf("%-8s %14s %9s %10s\n", "workers", "frames/s", "speedup", "handoffs");
+
+    double base = 0;
+    uint16_t port = 19200;
+    for (size_t workers = 1; workers <= max_workers; workers *= 2)
+    {
+        double pct = 0;
+        double rate = run_case(workers, clients, seconds, port++, &pct);
+        if (workers == 1) base = rate;
+        printf("%-8zu %14.0f %8.2fx %9.1f%%\n", workers, rate, base > 0 ? rate / base : 0.0, pct);
+    }
+    return 0;
+}
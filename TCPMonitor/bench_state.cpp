@@ -0,0 +1,121 @@
+/* -------------------- STATE TABLE STRESS --------------------
+ * One writer hammers every device slot while reader threads snapshot them
+ * as fast as they can. Each write keeps all fields derived from one counter,
+ * so any mix of two writes in a snapshot is detected as a torn read.
+ * The same run is repeated with a mutex-guarded table for comparison.
+ *
+ *   ./bench_state [readers] [seconds]
+ */
+
+#include "device_table.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static constexpr size_t DEVICES = 64;
+
+static DeviceState make_state(uint32_t i)
+{
+    DeviceState s;
+    for (size_t k = 0; k < DEVICE_VALUES; ++k)
+        s.values[k] = static_cast<float>(i % 100000 + k);
+    s.type   = static_cast<uint8_t>(i);
+    s.seen   = true;
+    s.last_update = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(i));
+    return s;
+}
+
+static bool consistent(const DeviceState& s)
+{
+    if (!s.seen) return true;   // initial slot, never written
+    auto i = static_cast<uint32_t>(s.last_update.time_since_epoch().count());
+    for (size_t k = 0; k < DEVICE_VALUES; ++k)
+        if (s.values[k] != static_cast<float>(i % 100000 + k)) return false;
+    return s.type == static_cast<uint8_t>(i) &&
+           s.last_update.time_since_epoch() == std::chrono::nanoseconds(i);
+}
+
+struct LockedTable
+{
+    std::mutex mutex;
+    DeviceState slots[DEVICES];
+
+    void store(size_t dev, const DeviceState& s)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[dev] = s;
+    }
+    DeviceState load(size_t dev)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return slots[dev];
+    }
+};
+
+template <class Table>
+static uint64_t run(const char* name, Table& table, int readers, double seconds)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0}, torn{0};
+    uint64_t writes = 0;
+
+    std::vector<std::thread> pool;
+    for (int r = 0; r < readers; ++r)
+    {
+        pool.emplace_back([&] {
+            uint64_t n = 0, bad = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                for (size_t dev = 0; dev < DEVICES; ++dev)
+                {
+                    if (!consistent(table.load(dev))) ++bad;
+                    ++n;
+                }
+            }
+            reads += n;
+            torn += bad;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration<double>(seconds);
+    uint32_t i = 0;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        for (int k = 0; k < 1024; ++k)
+        {
+            ++i;
+            table.store(i % DEVICES, make_state(i));
+            ++writes;
+        }
+    }
+    stop = true;
+    for (auto& t : pool) t.join();
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%-8s writes=%.2fM/s reads=%.2fM/s torn=%llu\n", name,
+           writes / secs / 1e6, reads.load() / secs / 1e6,
+           (unsigned long long)torn.load());
+    return torn.load();
+}
+
+int main(int argc, char** argv)
+{
+    int readers    = argc > 1 ? atoi(argv[1]) : 3;
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+
+    printf("[BENCH] 1 writer, %d readers, %zu devices, %.1fs each\n", readers, DEVICES, seconds);
+
+    static DeviceTable seqlock;
+    uint64_t torn = run("seqlock", seqlock, readers, seconds);
+
+    static LockedTable locked;
+    run("mutex", locked, readers, seconds);
+
+    return torn == 0 ? 0 : 1;
+}
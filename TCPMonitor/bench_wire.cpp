@@ -0,0 +1,163 @@
+/* -------------------- WIRE FORMAT BENCHMARK --------------------
+ * Compares the ASCII "DEV=..,TYPE=..\n" frames with scada_wire binary
+ * frames carrying the same readings: bytes on the wire, firmware-side
+ * encode cost (snprintf vs scada_wire_encode) and gateway-side decode cost
+ * (parse_frame on both). Also checks that every binary frame round-trips
+ * to the same values as its ASCII twin, that the CRC matches the
+ * CRC-16/CCITT-FALSE check value, that a flipped bit is rejected and that
+ * a NaN or Inf reading is refused like it is in ASCII.
+ *
+ *   ./bench_wire [iterations]
+ */
+
+#include "frame_parser.h"
+
+#include <scada_wire.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct Reading
+{
+    scada_wire_frame w;
+    char ascii[64];
+    size_t ascii_len;
+    uint8_t bin[SCADA_WIRE_FRAME_SIZE];
+};
+
+// same snprintf formats as the firmware senders
+static size_t encode_ascii(const scada_wire_frame& w, char* out, size_t room)
+{
+    int n = 0;
+    switch (w.type)
+    {
+    case SCADA_WIRE_ENV:
+        n = snprintf(out, room, "DEV=%d,TYPE=ENV,TEMP=%.1f,HUM=%.1f\n", w.dev, w.u.env.temp, w.u.env.hum);
+        break;
+    case SCADA_WIRE_KEYPAD:
+        n = snprintf(out, room, "DEV=%d,TYPE=KEYPAD,KEY=%c\n", w.dev, w.u.keypad.key);
+        break;
+    case SCADA_WIRE_SENSOR:
+        n = snprintf(out, room, "DEV=%d,TYPE=SENSOR,GPIO=%d,STATE=%d\n", w.dev, w.u.sensor.gpio, w.u.sensor.state);
+        break;
+    case SCADA_WIRE_ROTARY:
+        n = snprintf(out, room, "DEV=%d,TYPE=ROTARY,L=%d,R=%d\n", w.dev, w.u.rotary.left, w.u.rotary.right);
+        break;
+    }
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+static bool same(const Frame& a, const Frame& b)
+{
+    return a.dev == b.dev && a.type == b.type && a.key == b.key &&
+           a.state == b.state && a.left == b.left && a.right == b.right &&
+           std::fabs(a.temp - b.temp) < 1e-4f && std::fabs(a.hum - b.hum) < 1e-4f;
+}
+
+int main(int argc, char** argv)
+{
+    long iters = argc > 1 ? atol(argv[1]) : 200000;
+    bool ok = true;
+
+    std::vector<Reading> set(8);
+    for (size_t i = 0; i < set.size(); ++i)
+    {
+        scada_wire_frame& w = set[i].w;
+        memset(&w, 0, sizeof(w));
+        w.seq = static_cast<uint32_t>(i);
+        w.time_ms = 1700000000000ull + i * 3000;
+        switch (i % 4)
+        {
+        case 0: w.type = SCADA_WIRE_ENV;    w.dev = 0; w.u.env.temp = 23.0f + i; w.u.env.hum = 41.5f; break;
+        case 1: w.type = SCADA_WIRE_KEYPAD; w.dev = 1; w.u.keypad.key = static_cast<char>('0' + i); break;
+        case 2: w.type = SCADA_WIRE_SENSOR; w.dev = 2; w.u.sensor.gpio = 18; w.u.sensor.state = i & 1; break;
+        case 3: w.type = SCADA_WIRE_ROTARY; w.dev = 3; w.u.rotary.left = 1; w.u.rotary.right = 0; break;
+        }
+        set[i].ascii_len = encode_ascii(w, set[i].ascii, sizeof(set[i].ascii));
+        scada_wire_encode(&w, set[i].bin);
+    }
+
+    // correctness
+    const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    if (scada_wire_crc16(check, sizeof(check)) != 0x29B1)
+    {
+        printf("[BENCH] CRC check value mismatch\n");
+        ok = false;
+    }
+
+    size_t ascii_bytes = 0;
+    for (const Reading& r : set)
+    {
+        Frame a, b;
+        ascii_bytes += r.ascii_len;
+        if (parse_frame(r.ascii, r.ascii_len - 1, a) != ParseStatus::Ok ||
+            parse_frame(reinterpret_cast<const char*>(r.bin), sizeof(r.bin), b) != ParseStatus::Ok ||
+            !same(a, b) || b.seq != r.w.seq || b.time_ms != r.w.time_ms)
+        {
+            printf("[BENCH] round-trip mismatch: %.*s", static_cast<int>(r.ascii_len), r.ascii);
+            ok = false;
+        }
+
+        uint8_t bad[SCADA_WIRE_FRAME_SIZE];
+        memcpy(bad, r.bin, sizeof(bad));
+        bad[20] ^= 0x04;
+        if (parse_frame(reinterpret_cast<const char*>(bad), sizeof(bad), b) != ParseStatus::BadChecksum)
+        {
+            printf("[BENCH] corrupted frame accepted\n");
+            ok = false;
+        }
+    }
+
+    // a NaN or Inf reading is refused like its ASCII form
+    for (float v : { std::nanf(""), HUGE_VALF })
+    {
+        scada_wire_frame w = set[0].w;
+        w.u.env.temp = v;
+        uint8_t bin[SCADA_WIRE_FRAME_SIZE];
+        scada_wire_encode(&w, bin);
+        Frame b;
+        if (parse_frame(reinterpret_cast<const char*>(bin), sizeof(bin), b) != ParseStatus::MissingField)
+        {
+            printf("[BENCH] non-finite temperature accepted\n");
+            ok = false;
+        }
+    }
+
+    // timing
+    using Clock = std::chrono::steady_clock;
+    volatile int sink = 0;
+    char abuf[64];
+    uint8_t bbuf[SCADA_WIRE_FRAME_SIZE];
+    Frame f;
+
+    auto t0 = Clock::now();
+    for (long i = 0; i < iters; ++i)
+        for (const Reading& r : set) sink += static_cast<int>(encode_ascii(r.w, abuf, sizeof(abuf)));
+    auto t1 = Clock::now();
+    for (long i = 0; i < iters; ++i)
+        for (const Reading& r : set) sink += static_cast<int>(scada_wire_encode(&r.w, bbuf));
+    auto t2 = Clock::now();
+    for (long i = 0; i < iters; ++i)
+        for (const Reading& r : set) { parse_frame(r.ascii, r.ascii_len - 1, f); sink += f.dev; }
+    auto t3 = Clock::now();
+    for (long i = 0; i < iters; ++i)
+        for (const Reading& r : set) { parse_frame(reinterpret_cast<const char*>(r.bin), sizeof(r.bin), f); sink += f.dev; }
+    auto t4 = Clock::now();
+
+    double n = static_cast<double>(iters) * set.size();
+    auto ns = [&](Clock::time_point a, Clock::time_point b) {
+        return std::chrono::duration<double, std::nano>(b - a).count() / n;
+    };
+
+    printf("[BENCH] %zu frames x %ld iterations\n", set.size(), iters);
+    printf("%-8s %10s %12s %12s\n", "format", "bytes", "encode ns", "decode ns");
+    printf("%-8s %10.1f %12.1f %12.1f   (no seq / timestamp / CRC)\n", "ascii",
+           double(ascii_bytes) / set.size(), ns(t0, t1), ns(t2, t3));
+    printf("%-8s %10d %12.1f %12.1f\n", "binary", SCADA_WIRE_FRAME_SIZE, ns(t1, t2), ns(t3, t4));
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/* -------------------- DEVICE TABLE --------------------
+ * Dense state table indexed directly by the DEV id from the frame header.
+ * One cache line per device, so the ingest writer and the publish reader
+ * never share a line between two devices, and no lock between them.
+ *
+ * The DNP3 layout of every device comes from the point map (point_map.h).
+ * values[] mirrors the last value of the map's first DEVICE_VALUES points
+ * (by route id); points beyond that are published and recorded but not
+ * kept here, so a device still fits one line.
+ */
+
+static constexpr size_t MAX_DEVICES = 256;
+static constexpr size_t DEVICE_VALUES = 8;
+
+struct DeviceState
+{
+    float values[DEVICE_VALUES] = {};
+    uint8_t type = 0;           // point map type id of the last frame
+    bool seen = false;
+    uint32_t events = 0;        // frames that raised an event=every/soe event, repeats included
+    std::chrono::steady_clock::time_point last_update =
+        std::chrono::steady_clock::now() - std::chrono::hours(24);
+};
+
+static_assert(std::is_trivially_copyable_v<DeviceState>, "DeviceState is copied word-wise");
+
+/* One device slot published through a seqlock. There is exactly one writer
+ * per slot (the ingest thread that owns the device), so store() never waits;
+ * load() retries only if it overlapped a store. The payload lives in relaxed
+ * atomic words so concurrent copies are well-defined.
+ */
+class alignas(64) DeviceSlot
+{
+public:
+    DeviceSlot() { store(DeviceState{}); }
+
+    void store(const DeviceState& s)
+    {
+        uint64_t tmp[WORDS]{};
+        memcpy(tmp, &s, sizeof(s));
+
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WORDS; ++i)
+            words_[i].store(tmp[i], std::memory_order_relaxed);
+
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    DeviceState load() const
+    {
+        uint64_t tmp[WORDS];
+        uint32_t before, after;
+
+        do
+        {
+            before = seq_.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; ++i)
+                tmp[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        DeviceState s;
+        memcpy(&s, tmp, sizeof(s));
+        return s;
+    }
+
+private:
+    static constexpr size_t WORDS = (sizeof(DeviceState) + 7) / 8;
+
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<uint64_t> words_[WORDS];
+};
+
+class DeviceTable
+{
+public:
+    static bool valid(int dev) { return dev >= 0 && static_cast<size_t>(dev) < MAX_DEVICES; }
+
+    DeviceState load(size_t dev) const { return slots_[dev].load(); }
+
+    // Single writer per device: only the ingest thread that owns `dev`
+    void store(size_t dev, const DeviceState& s) { slots_[dev].store(s); }
+
+    size_t size() const { return slots_.size(); }
+
+private:
+    std::array<DeviceSlot, MAX_DEVICES> slots_;
+};
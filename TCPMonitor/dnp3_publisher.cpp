@@ -0,0 +1,233 @@
+#include "dnp3_publisher.h"
+
+#include <opendnp3/outstation/UpdateBuilder.h>
+
+#include <cmath>
+
+using namespace opendnp3;
+
+static constexpr uint8_t FLAG_ONLINE = 0x01;
+
+uint64_t wall_clock_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static DNPTime stamp(uint64_t time_ms)
+{
+    return DNPTime(time_ms, TimestampQuality::SYNCHRONIZED);
+}
+
+Dnp3Publisher::Dnp3Publisher(std::shared_ptr<IOutstation> outstation, const PointMap& map,
+                             size_t devices, BatchConfig batch)
+    : outstation_(std::move(outstation)),
+      map_(map),
+      batch_(batch),
+      online_last_(new std::atomic<int8_t>[devices]),
+      devices_(devices)
+{
+    for (PointKind kind : { PointKind::Binary, PointKind::Analog, PointKind::Counter })
+    {
+        size_t n = map.points(kind, devices);
+        PointTable& t = table(kind);
+        t.last.assign(n, 0.0);
+        t.time.assign(n, 0);
+        t.deadband.assign(n, 0.0);
+        t.valid.assign(n, 0);
+        t.dirty.assign(n, 0);
+        t.committed.resize(n);
+    }
+
+    for (const PointRoute& r : map.routes())
+        for (size_t dev = 0; dev < devices; ++dev)
+            table(r.kind).deadband[map.index(dev, r)] = r.deadband;
+
+    for (size_t i = 0; i < devices; ++i) online_last_[i].store(-1);
+    soe_.resize(devices);
+}
+
+bool Dnp3Publisher::changed(PointTable& t, uint16_t index, double value, uint64_t time_ms)
+{
+    if (t.valid[index])
+    {
+        // same rule as opendnp3: an event needs |delta| > deadband
+        double delta = std::fabs(value - t.last[index]);
+        if (delta == 0.0 || delta <= t.deadband[index]) return false;
+    }
+
+    t.last[index] = value;
+    t.time[index] = time_ms;
+    t.valid[index] = 1;
+    return true;
+}
+
+void Dnp3Publisher::mark(PointKind kind, uint16_t index, std::chrono::steady_clock::time_point committed)
+{
+    PointTable& t = table(kind);
+    if (t.dirty[index])
+    {
+        stats_.coalesced.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    t.dirty[index] = 1;
+    t.committed[index] = committed;
+    t.dirty_list.push_back(index);
+    ++pending_;
+}
+
+void Dnp3Publisher::push_edge(size_t dev, const SoeEntry& e)
+{
+    SoeRing& ring = soe_[dev];
+    bool reordered = false;
+    if (!ring.push(e, reordered))
+    {
+        stats_.soe_full.fetch_add(1, std::memory_order_relaxed);
+        flush();
+        ring.push(e, reordered);
+    }
+
+    if (ring.size() == 1) soe_pending_.push_back(static_cast<uint16_t>(dev));
+    if (reordered) stats_.soe_reordered.fetch_add(1, std::memory_order_relaxed);
+    ++pending_;
+}
+
+void Dnp3Publisher::publish(size_t dev, const MappedFrame& m, uint64_t time_ms, bool has_seq, uint32_t seq,
+                            std::chrono::steady_clock::time_point committed)
+{
+    if (dev >= devices_) return;
+
+    if (pending_ == 0) batch_start_ = std::chrono::steady_clock::now();
+    bool any = false;
+
+    for (size_t i = 0; i < m.count; ++i)
+    {
+        const PointRoute& r = map_.route(m.values[i].route);
+        uint16_t index = map_.index(dev, r);
+        PointTable& t = table(r.kind);
+
+        if (r.every)
+        {
+            t.last[index] = m.values[i].value;
+            t.time[index] = time_ms;
+            t.valid[index] = 1;
+        }
+        else if (!changed(t, index, m.values[i].value, time_ms))
+        {
+            continue;
+        }
+
+        if (r.soe) push_edge(dev, SoeEntry{ time_ms, seq, has_seq, r.kind, index, t.last[index], committed });
+        else mark(r.kind, index, committed);
+        any = true;
+    }
+
+    if (!any) return;
+    stats_.frames.fetch_add(1, std::memory_order_relaxed);
+
+    if (batch_.window.count() == 0 || pending_ >= batch_.max_changes)
+        flush();
+}
+
+static void add_update(UpdateBuilder& b, PointKind kind, uint16_t index, double value, uint64_t time_ms,
+                       EventMode mode = EventMode::Detect)
+{
+    switch (kind)
+    {
+    case PointKind::Binary:
+        b.Update(Binary(value != 0.0, Flags(FLAG_ONLINE), stamp(time_ms)), index, mode);
+        break;
+    case PointKind::Analog:
+        b.Update(Analog(value, Flags(FLAG_ONLINE), stamp(time_ms)), index, mode);
+        break;
+    case PointKind::Counter:
+        b.Update(Counter(static_cast<uint32_t>(value), Flags(FLAG_ONLINE), stamp(time_ms)), index, mode);
+        break;
+    }
+}
+
+int Dnp3Publisher::flush_due()
+{
+    if (pending_ == 0) return -1;
+
+    auto elapsed = std::chrono::steady_clock::now() - batch_start_;
+    if (elapsed >= batch_.window)
+    {
+        flush();
+        return -1;
+    }
+
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(batch_.window - elapsed);
+    return static_cast<int>(left.count()) + 1;
+}
+
+void Dnp3Publisher::flush()
+{
+    if (pending_ == 0) return;
+
+    UpdateBuilder b;
+
+    for (PointKind kind : { PointKind::Binary, PointKind::Analog, PointKind::Counter })
+    {
+        PointTable& t = table(kind);
+        for (uint16_t index : t.dirty_list)
+        {
+            add_update(b, kind, index, t.last[index], t.time[index]);
+            t.dirty[index] = 0;
+        }
+    }
+
+    uint64_t edges = 0;
+    for (uint16_t dev : soe_pending_)
+    {
+        edges += soe_[dev].size();
+        soe_[dev].drain([&](const SoeEntry& e) {
+            add_update(b, e.kind, e.index, e.value, e.time_ms, EventMode::Force);
+            if (trace_) soe_committed_.push_back(e.committed);
+        });
+    }
+
+    bool timed = trace_ || apply_metric_;
+    auto apply_start = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+    outstation_->Apply(b.Build());
+
+    if (timed)
+    {
+        auto applied = std::chrono::steady_clock::now();
+        auto ns = [&](std::chrono::steady_clock::time_point t) {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(applied - t).count();
+        };
+
+        if (apply_metric_) apply_metric_->observe_ns(ns(apply_start));
+        if (trace_)
+        {
+            trace_->apply.record(ns(apply_start));
+            for (const PointTable& t : tables_)
+                for (uint16_t index : t.dirty_list) trace_->commit_to_apply.record(ns(t.committed[index]));
+            for (auto committed : soe_committed_) trace_->commit_to_apply.record(ns(committed));
+        }
+    }
+
+    uint64_t n = pending_;
+    stats_.batches.fetch_add(1, std::memory_order_relaxed);
+    stats_.points.fetch_add(n, std::memory_order_relaxed);
+    stats_.soe_events.fetch_add(edges, std::memory_order_relaxed);
+    if (n > stats_.max_batch.load(std::memory_order_relaxed))
+        stats_.max_batch.store(n, std::memory_order_relaxed);
+
+    for (PointTable& t : tables_) t.dirty_list.clear();
+    soe_pending_.clear();
+    soe_committed_.clear();
+    pending_ = 0;
+}
+
+void Dnp3Publisher::publish_online(size_t dev, bool online)
+{
+    if (dev >= devices_) return;
+    if (online_last_[dev].exchange(static_cast<int8_t>(online)) == static_cast<int8_t>(online))
+        return;
+
+    UpdateBuilder b;
+    b.Update(Binary(online, Flags(FLAG_ONLINE), stamp(wall_clock_ms())), map_.online_index(dev));
+    outstation_->Apply(b.Build());
+}
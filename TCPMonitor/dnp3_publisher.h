@@ -0,0 +1,132 @@
+#pragma once
+
+#include "point_map.h"
+#include "soe_ring.h"
+#include "latency_histogram.h"
+#include "metrics.h"
+
+#include <opendnp3/outstation/IOutstation.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/* -------------------- DNP3 PUBLISHER --------------------
+ * Turns the mapped values of each frame into DNP3 updates as ingest
+ * commits them, at the indices the point map gives. Only points whose
+ * value moved (past the point's deadband) are queued, and nothing is
+ * applied when a frame changes nothing.
+ *
+ * Changes are coalesced for up to `window` or `max_changes` points and
+ * then applied as one UpdateBuilder. A point written several times in a
+ * window is sent once with its latest value. Points mapped event=soe or
+ * event=every are edges instead: every change (every frame for the
+ * keypad) goes into the device's SoeRing and is applied as its own forced
+ * event, oldest device time first, so an on/off pair inside one window
+ * reaches the master as two events.
+ *
+ * Every point carries the time (ms since epoch) the caller passes: the
+ * device's own timestamp when the frame had one, so event variations with
+ * time give the master when the edge happened, not when it arrived.
+ *
+ * With tracing on, every applied point records how long it waited from
+ * its state commit (DeviceState::last_update) until Apply() returned, and
+ * every Apply() its own duration; the Apply() duration also feeds an
+ * optional metrics histogram. Apply() only queues the update on the
+ * stack's executor, so encoding and transmission show up on the master.
+ *
+ * publish() and flush_due() run only on the ingest thread. With several
+ * ingest workers each owns its own publisher for the devices it owns; all
+ * of them Apply() to the same outstation, which is safe from any thread. publish_online()
+ * bypasses the batch; it too runs only on the owning ingest thread (the
+ * supervision loop in main() asks for the check through a wake), so ONLINE
+ * cannot be cleared from a stale read right after ingest set it.
+ */
+
+struct BatchConfig
+{
+    std::chrono::milliseconds window{10};
+    size_t max_changes = 64;
+};
+
+struct PublishStats
+{
+    std::atomic<uint64_t> frames{0};      // publish() calls that changed something
+    std::atomic<uint64_t> batches{0};     // Apply() calls actually made
+    std::atomic<uint64_t> points{0};      // points applied
+    std::atomic<uint64_t> coalesced{0};   // point writes merged into a pending one
+    std::atomic<uint64_t> max_batch{0};
+    std::atomic<uint64_t> soe_events{0};      // edges applied from the SOE rings
+    std::atomic<uint64_t> soe_reordered{0};   // edges slotted in before later ones
+    std::atomic<uint64_t> soe_full{0};        // early Apply() because a ring filled up
+};
+
+struct PublishTrace
+{
+    LatencyHistogram commit_to_apply;   // per point, state commit -> Apply() returned
+    LatencyHistogram apply;             // per batch, duration of Apply()
+};
+
+uint64_t wall_clock_ms();
+
+class Dnp3Publisher
+{
+public:
+    // `map` must outlive the publisher
+    Dnp3Publisher(std::shared_ptr<opendnp3::IOutstation> outstation, const PointMap& map,
+                  size_t devices, BatchConfig batch = BatchConfig{});
+
+    void set_tracing(PublishTrace* trace) { trace_ = trace; }   // nullptr = off
+    void set_apply_metric(MetricHistogram* h) { apply_metric_ = h; }
+
+    // `seq` orders edges with the same device time when `has_seq`
+    void publish(size_t dev, const MappedFrame& m, uint64_t time_ms, bool has_seq, uint32_t seq,
+                 std::chrono::steady_clock::time_point committed);
+    void publish_online(size_t dev, bool online);
+
+    // Applies the pending batch if its window has elapsed; returns ms until
+    // the current batch is due, or -1 when nothing is pending.
+    int flush_due();
+    void flush();
+
+    const PublishStats& stats() const { return stats_; }
+
+private:
+    // one per PointKind, indexed by DNP3 index
+    struct PointTable
+    {
+        std::vector<double> last;
+        std::vector<uint64_t> time;
+        std::vector<double> deadband;
+        std::vector<uint8_t> valid;
+
+        // pending batch, ingest thread only
+        std::vector<uint8_t> dirty;
+        std::vector<uint16_t> dirty_list;
+        std::vector<std::chrono::steady_clock::time_point> committed;   // oldest pending commit
+    };
+
+    bool changed(PointTable& t, uint16_t index, double value, uint64_t time_ms);
+    void mark(PointKind kind, uint16_t index, std::chrono::steady_clock::time_point committed);
+    void push_edge(size_t dev, const SoeEntry& e);
+    PointTable& table(PointKind kind) { return tables_[static_cast<size_t>(kind)]; }
+
+    std::shared_ptr<opendnp3::IOutstation> outstation_;
+    const PointMap& map_;
+    BatchConfig batch_;
+    PublishStats stats_;
+    PublishTrace* trace_ = nullptr;   // may be shared by several publishers
+    MetricHistogram* apply_metric_ = nullptr;   // Apply() duration for /metrics
+
+    PointTable tables_[POINT_KINDS];
+    std::unique_ptr<std::atomic<int8_t>[]> online_last_;   // -1 = never published
+    size_t devices_;
+
+    std::vector<SoeRing> soe_;               // per device
+    std::vector<uint16_t> soe_pending_;      // devices with edges in their ring
+    std::vector<std::chrono::steady_clock::time_point> soe_committed_;   // tracing only
+    size_t pending_ = 0;
+    std::chrono::steady_clock::time_point batch_start_;
+};
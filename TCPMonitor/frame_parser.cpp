@@ -0,0 +1,284 @@
+#include "frame_parser.h"
+
+#include <scada_wire.h>
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace
+{
+
+enum : uint16_t
+{
+    F_DEV   = 1 << 0,
+    F_TYPE  = 1 << 1,
+    F_TEMP  = 1 << 2,
+    F_HUM   = 1 << 3,
+    F_KEY   = 1 << 4,
+    F_GPIO  = 1 << 5,
+    F_STATE = 1 << 6,
+    F_L     = 1 << 7,
+    F_R     = 1 << 8,
+    F_SEQ   = 1 << 9,
+    F_TS    = 1 << 10,
+
+    F_HEADER = F_DEV | F_TYPE | F_SEQ | F_TS
+};
+
+// from_chars also takes "nan" and "inf", which are no reading
+template <class T>
+bool to_num(std::string_view v, T& out)
+{
+    const char* end = v.data() + v.size();
+    auto r = std::from_chars(v.data(), end, out);
+    if (r.ec != std::errc() || r.ptr != end) return false;
+    if constexpr (std::is_floating_point_v<T>) return std::isfinite(out);
+    return true;
+}
+
+// a number that to_num() refused only for not being finite
+bool non_finite(std::string_view v)
+{
+    double d;
+    auto r = std::from_chars(v.data(), v.data() + v.size(), d);
+    return r.ec == std::errc() && r.ptr == v.data() + v.size() && !std::isfinite(d);
+}
+
+// keypad keys '0'..'9' count as their digit, anything else as its code
+double key_value(char k)
+{
+    if (k >= '0' && k <= '9') return k - '0';
+    return static_cast<unsigned char>(k);
+}
+
+void add_field(Frame& f, std::string_view key, double value)
+{
+    if (f.field_count < FRAME_FIELDS_MAX) f.fields[f.field_count++] = { key, value };
+}
+
+// value of a typed field for Frame::fields, without parsing it again
+double typed_value(int bit, const Frame& f)
+{
+    switch (bit)
+    {
+    case F_TEMP:  return f.temp;
+    case F_HUM:   return f.hum;
+    case F_KEY:   return key_value(f.key);
+    case F_GPIO:  return f.gpio;
+    case F_STATE: return f.state;
+    case F_L:     return f.left;
+    default:      return f.right;
+    }
+}
+
+FrameType lookup_type(std::string_view t)
+{
+    switch (t.size())
+    {
+    case 3:
+        if (t == "ENV") return FrameType::Env;
+        break;
+    case 6:
+        if (t == "KEYPAD") return FrameType::Keypad;
+        if (t == "SENSOR") return FrameType::Sensor;
+        if (t == "ROTARY") return FrameType::Rotary;
+        break;
+    }
+    return FrameType::Unknown;
+}
+
+uint16_t required_fields(FrameType type)
+{
+    switch (type)
+    {
+    case FrameType::Env:    return F_TEMP | F_HUM;
+    case FrameType::Keypad: return F_KEY;
+    case FrameType::Sensor: return F_STATE;
+    case FrameType::Rotary: return F_L | F_R;
+    default:                return 0;
+    }
+}
+
+// Returns the field bit that was set, 0 for an unknown key, or -1 when a
+// known key carries a malformed value.
+int apply_pair(std::string_view key, std::string_view val, Frame& f)
+{
+    switch (key.size())
+    {
+    case 1:
+        if (key[0] == 'L') return to_num(val, f.left)  ? F_L : -1;
+        if (key[0] == 'R') return to_num(val, f.right) ? F_R : -1;
+        break;
+    case 2:
+        if (key == "TS") return to_num(val, f.time_ms) ? F_TS : -1;
+        break;
+    case 3:
+        if (key == "DEV") return to_num(val, f.dev) ? F_DEV : -1;
+        if (key == "SEQ")
+        {
+            f.has_seq = to_num(val, f.seq);
+            return f.has_seq ? F_SEQ : -1;
+        }
+        if (key == "HUM") return to_num(val, f.hum) ? F_HUM : -1;
+        if (key == "KEY")
+        {
+            if (val.empty()) return -1;
+            f.key = val[0];
+            return F_KEY;
+        }
+        break;
+    case 4:
+        if (key == "TYPE")
+        {
+            f.type_name = val;
+            f.type = lookup_type(val);
+            return F_TYPE;
+        }
+        if (key == "TEMP") return to_num(val, f.temp) ? F_TEMP : -1;
+        if (key == "GPIO") return to_num(val, f.gpio) ? F_GPIO : -1;
+        break;
+    case 5:
+        if (key == "STATE") return to_num(val, f.state) ? F_STATE : -1;
+        break;
+    }
+    return 0;
+}
+
+ParseStatus parse_binary(const char* data, size_t len, Frame& f)
+{
+    scada_wire_frame w;
+    f.binary = true;
+
+    switch (scada_wire_decode(reinterpret_cast<const uint8_t*>(data), len, &w))
+    {
+    case SCADA_WIRE_OK:
+        break;
+    case SCADA_WIRE_BAD_CRC:
+        return ParseStatus::BadChecksum;
+    case SCADA_WIRE_BAD_TYPE:
+        f.type_name = "UNKNOWN";
+        return ParseStatus::UnknownType;
+    default:
+        return ParseStatus::BadHeader;
+    }
+
+    f.dev = w.dev;
+    f.has_seq = true;
+    f.seq = w.seq;
+    f.time_ms = w.time_ms;
+
+    switch (w.type)
+    {
+    case SCADA_WIRE_ENV:
+        f.type = FrameType::Env;
+        f.temp = w.u.env.temp;
+        f.hum = w.u.env.hum;
+        // same rule as the text path: NaN or Inf is no reading
+        if (!std::isfinite(f.temp) || !std::isfinite(f.hum)) return ParseStatus::MissingField;
+        add_field(f, "TEMP", f.temp);
+        add_field(f, "HUM", f.hum);
+        break;
+    case SCADA_WIRE_KEYPAD:
+        f.type = FrameType::Keypad;
+        f.key = w.u.keypad.key;
+        add_field(f, "KEY", key_value(f.key));
+        break;
+    case SCADA_WIRE_SENSOR:
+        f.type = FrameType::Sensor;
+        f.gpio = w.u.sensor.gpio;
+        f.state = w.u.sensor.state;
+        add_field(f, "GPIO", f.gpio);
+        add_field(f, "STATE", f.state);
+        break;
+    case SCADA_WIRE_ROTARY:
+        f.type = FrameType::Rotary;
+        f.left = w.u.rotary.left;
+        f.right = w.u.rotary.right;
+        add_field(f, "L", f.left);
+        add_field(f, "R", f.right);
+        break;
+    case SCADA_WIRE_PASSCODE:
+        f.type = FrameType::Passcode;
+        f.passcode_ok = w.u.passcode.ok != 0;
+        break;
+    }
+    f.type_name = frame_type_name(f.type);
+    return ParseStatus::Ok;
+}
+
+} // namespace
+
+ParseStatus parse_frame(const char* data, size_t len, Frame& out)
+{
+    out = Frame{};
+    if (len > 0 && static_cast<uint8_t>(data[0]) == SCADA_WIRE_MAGIC0)
+        return parse_binary(data, len, out);
+
+    std::string_view in(data, len);
+
+    if (in == "PASSWORD_CORRECT" || in == "PASSWORD_INCORRECT")
+    {
+        out.type = FrameType::Passcode;
+        out.type_name = "PASSCODE";
+        out.passcode_ok = (in == "PASSWORD_CORRECT");
+        return ParseStatus::Ok;
+    }
+
+    uint16_t seen = 0;
+    bool malformed = false;
+    const char* p = data;
+    const char* end = data + len;
+
+    while (p < end)
+    {
+        const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+        const char* tok_end = comma ? comma : end;
+        const char* eq = static_cast<const char*>(memchr(p, '=', tok_end - p));
+
+        if (eq)
+        {
+            std::string_view key(p, eq - p);
+            std::string_view val(eq + 1, tok_end - eq - 1);
+            int bit = apply_pair(key, val, out);
+            double v;
+
+            if (bit < 0 || (bit == 0 && non_finite(val))) malformed = true;
+            else seen |= static_cast<uint16_t>(bit);
+
+            if (bit > 0 && !(bit & F_HEADER)) add_field(out, key, typed_value(bit, out));
+            else if (bit == 0 && to_num(val, v)) add_field(out, key, v);
+            else if (bit == 0 && val.size() == 1) add_field(out, key, key_value(val[0]));
+        }
+
+        if (!comma) break;
+        p = comma + 1;
+    }
+
+    if ((seen & (F_DEV | F_TYPE)) != (F_DEV | F_TYPE) || out.type_name.empty())
+        return ParseStatus::BadHeader;
+
+    // a TYPE only the point map knows must not slip a bad value through either
+    if (out.type == FrameType::Unknown)
+        return malformed ? ParseStatus::MissingField : ParseStatus::UnknownType;
+
+    uint16_t need = required_fields(out.type);
+    if ((seen & need) != need || malformed)
+        return ParseStatus::MissingField;
+
+    return ParseStatus::Ok;
+}
+
+const char* frame_type_name(FrameType type)
+{
+    switch (type)
+    {
+    case FrameType::Env:      return "ENV";
+    case FrameType::Keypad:   return "KEYPAD";
+    case FrameType::Sensor:   return "SENSOR";
+    case FrameType::Rotary:   return "ROTARY";
+    case FrameType::Passcode: return "PASSCODE";
+    default:                  return "UNKNOWN";
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/* -------------------- FRAME PARSER --------------------
+ * Single pass over "DEV=<id>,TYPE=<type>,KEY=VALUE,..." with no heap
+ * allocation and no locale-dependent number parsing. Keys the gateway
+ * does not know are skipped, so firmware can add fields freely.
+ *
+ * Frames starting with SCADA_WIRE_MAGIC0 are fixed-size binary frames
+ * (scada_wire.h) and are decoded into the same Frame, with the sequence
+ * number and device timestamp they carry.
+ *
+ * Besides the typed members, every numeric field is also listed in
+ * Frame::fields for the point map (point_map.h). A TYPE the parser does
+ * not know still returns UnknownType, with its fields collected, so the
+ * gateway can route it when the map lists it.
+ */
+
+enum class FrameType : uint8_t
+{
+    Unknown,
+    Env,        // TEMP, HUM
+    Keypad,     // KEY
+    Sensor,     // GPIO, STATE
+    Rotary,     // L, R
+    Passcode    // bare PASSWORD_CORRECT / PASSWORD_INCORRECT from the keypad
+};
+
+enum class ParseStatus : uint8_t
+{
+    Ok,
+    BadHeader,      // DEV or TYPE missing / malformed
+    UnknownType,
+    MissingField,   // a required value is absent, or a value is malformed or not finite
+    BadChecksum     // binary frame whose CRC does not match
+};
+
+struct FrameField
+{
+    std::string_view key;       // points into the parsed buffer
+    double value;
+};
+
+static constexpr size_t FRAME_FIELDS_MAX = 8;
+
+struct Frame
+{
+    int dev = -1;
+    FrameType type = FrameType::Unknown;
+    std::string_view type_name;     // points into the parsed buffer
+
+    float temp = 0.0f;
+    float hum = 0.0f;
+    char key = 0;
+    int gpio = 0;
+    int state = 0;
+    int left = 0;
+    int right = 0;
+    bool passcode_ok = false;
+
+    bool binary = false;        // decoded from a scada_wire frame
+    bool has_seq = false;       // binary frames, or SEQ= on ASCII frames
+    uint32_t seq = 0;
+    uint64_t time_ms = 0;       // device time (ms since epoch, TS= on ASCII), 0 if none
+
+    // KEY=VALUE pairs other than DEV/TYPE/SEQ/TS, in frame order; a single
+    // character that is not a number counts as its code (KEY=A -> 65)
+    FrameField fields[FRAME_FIELDS_MAX];
+    uint8_t field_count = 0;
+};
+
+ParseStatus parse_frame(const char* data, size_t len, Frame& out);
+
+const char* frame_type_name(FrameType type);
@@ -2,16 +2,39 @@
 
 #include <opendnp3/outstation/OutstationStackConfig.h>
 #include <opendnp3/outstation/UpdateBuilder.h>
-#include <opendnp3/outstation/SimpleCommandHandler.h>
+#include <opendnp3/outstation/ICommandHandler.h>
 #include <opendnp3/outstation/DefaultOutstationApplication.h>
 
 #include <opendnp3/channel/PrintingChannelListener.h>
 
+#include "ingest_server.h"
+#include "frame_parser.h"
+#include "device_table.h"
+#include "point_map.h"
+#include "dnp3_publisher.h"
+#include "async_log.h"
+#include "historian.h"
+#include "rollup.h"
+#include "seq_tracker.h"
+#include "latency_histogram.h"
+#include "metrics.h"
+#include "shard_queue.h"
+#include "mqtt_bridge.h"
+
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <string_view>
 #include <thread>
-#include <mutex>
+#include <vector>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <cstdio>
+#include <csignal>
 #include <unistd.h>
 #include <arpa/inet.h>
 
@@ -19,137 +42,841 @@ using namespace opendnp3;
 
 /* -------------------- SHARED STATE -------------------- */
 
-struct SensorState
+/* One ingest worker. With GATEWAY_INGEST_WORKERS=N the gateway runs N of
+ * them on SO_REUSEPORT sockets; worker i owns every device with
+ * dev % N == i and is the only writer of its device table slots, sequence
+ * state and DNP3 batch. Frames that arrive on another worker are parsed
+ * there and handed over through the owner's inbox.
+ */
+struct IngestShard
+{
+    size_t index = 0;
+    std::unique_ptr<Dnp3Publisher> publisher;
+    ShardQueue inbox;                           // frames parsed by other workers
+    std::atomic<IngestServer*> server{nullptr};
+    std::vector<uint8_t> wake_pending;          // owners to wake, own thread only
+    std::atomic<bool> online_due{false};        // set by main(), checked on the wake
+};
+
+static PointMap g_map;               // loaded in main() before ingest starts, then read-only
+static DeviceTable g_devices;        // each slot written only by its owning shard
+static size_t g_device_count = 16;   // devices exposed over DNP3, argv[1]
+static std::vector<std::unique_ptr<IngestShard>> g_shards;
+static std::atomic<size_t> g_shards_ready{0};
+static std::atomic<size_t> g_shards_failed{0};   // workers whose listener did not open
+static AsyncLog g_log;              // ingest never writes to the console itself
+static std::unique_ptr<Historian> g_history;   // appended by the ingest workers
+static std::unique_ptr<RollupEngine> g_rollups;  // summaries of the map's rollup points
+static SeqTracker g_seq;                       // gaps/duplicates of sequenced frames
+
+static IngestShard& shard_of(size_t dev)
+{
+    return *g_shards[dev % g_shards.size()];
+}
+
+/* -------------------- LATENCY TRACE --------------------
+ * GATEWAY_TRACE=1 stamps every frame through the gateway:
+ *   capture->receive   device TS / binary time_ms to wall clock at ingest
+ *                      (needs a synced device clock; others are skipped)
+ *   receive->parse     socket read to parsed Frame
+ *   parse->commit      seq check, history, rollups, log, device table store
+ *   commit->apply      DNP3 batch wait until Apply() returns (publisher)
+ * The master's [LATENCY] histogram covers the rest, ingest->SOE.
+ * kill -USR1 prints the histograms, kill -USR2 clears them.
+ */
+
+struct IngestTrace
 {
-    float temp = 0.0f;
-    float hum  = 0.0f;
-    int HrStatusSt = 0;
-    uint32_t keypad = 0;
-    int Left_ac = 0;
-    int Right_ac = 0;
-    std::chrono::steady_clock::time_point last_update =
-        std::chrono::steady_clock::now() - std::chrono::hours(24);
+    LatencyHistogram capture_to_receive;
+    LatencyHistogram receive_to_parse;
+    LatencyHistogram parse_to_commit;
 };
 
-static SensorState g_state;
-static std::mutex g_mutex;
+static bool g_tracing = false;
+static IngestTrace g_trace;
+static PublishTrace g_publish_trace;    // shared by every shard's publisher
+static volatile std::sig_atomic_t g_trace_dump = 0;
+static volatile std::sig_atomic_t g_trace_reset = 0;
 
-/* -------------------- INGEST THREAD -------------------- */
+// A device clock further ahead of ours than this is taken as not synced;
+// behind, frames a device queued through an outage keep their time for up
+// to DEVICE_BACKFILL_MS
+static constexpr uint64_t DEVICE_CLOCK_SKEW_MS = 3600 * 1000;
+static constexpr uint64_t DEVICE_BACKFILL_MS = 7 * 24 * 3600 * 1000ull;
 
-static uint32_t key_to_counter(char k)
+static bool device_time_ok(const Frame& f, uint64_t now_ms)
 {
-    if (k >= '0' && k <= '9') return k - '0';
-    return static_cast<uint32_t>(k);
+    return f.time_ms && f.time_ms + DEVICE_BACKFILL_MS > now_ms && f.time_ms < now_ms + DEVICE_CLOCK_SKEW_MS;
 }
 
-static void ingest_thread(uint16_t port)
+static int64_t elapsed_ns(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
 {
-    int server = socket(AF_INET, SOCK_STREAM, 0);
-    int opt = 1;
-    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+}
 
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(port);
+/* -------------------- METRICS --------------------
+ * Served as Prometheus text on GATEWAY_METRICS_PORT (default 9102, 0 = off).
+ * Counters are always kept; parse and state write timings only while the
+ * endpoint is up (or tracing is on), since they cost two clock reads each.
+ */
 
-    bind(server, (sockaddr*)&addr, sizeof(addr));
-    listen(server, 10);
+struct GatewayMetrics
+{
+    std::vector<MetricCounter*> accepted; // by point map type id
+    MetricCounter* passcode = nullptr;
+    MetricCounter* bad_header = nullptr;
+    MetricCounter* bad_crc = nullptr;
+    MetricCounter* unknown_type = nullptr;
+    MetricCounter* missing_field = nullptr;
+    MetricCounter* bad_dev = nullptr;
+    MetricCounter* duplicate = nullptr;
+    MetricHistogram* parse = nullptr;
+    MetricHistogram* state_write = nullptr;
+    MetricHistogram* apply = nullptr;
+    MetricCounter* handoffs = nullptr;
+    MetricCounter* handoff_full = nullptr;
+    MetricCounter* handoff_dropped = nullptr;
+};
 
-    std::cout << "[INGEST] Listening on " << port << "\n";
+static MetricsRegistry g_metrics;
+static GatewayMetrics g_m;
+static bool g_timed = false;    // metrics endpoint up or tracing on
 
-    while (true)
-    {
-        int client = accept(server, nullptr, nullptr);
-        if (client < 0) continue;
+static constexpr uint16_t METRICS_PORT = 9102;
+static std::unique_ptr<MqttBridge> g_mqtt;     // null when GATEWAY_MQTT_PORT=0
+static constexpr size_t MAX_INGEST_WORKERS = 16;
+
+static constexpr int ONLINE_TIMEOUT_S = 10;
+static constexpr int STATS_PERIOD_S = 60;
+static constexpr uint8_t HISTORY_QUALITY = 0x01;  // ONLINE, as published over DNP3
 
-        char buf[256]{};
-        int n = read(client, buf, sizeof(buf)-1);
-        close(client);
+/* -------------------- INGEST WORKERS -------------------- */
+
+static void apply_frame(IngestShard& shard, const Frame& f, const MappedFrame& m,
+                        std::chrono::steady_clock::time_point received,
+                        std::chrono::steady_clock::time_point parsed);
+
+// frames other workers parsed for devices this shard owns
+static void drain_inbox(IngestShard& shard)
+{
+    ShardFrame sf;
+    while (shard.inbox.pop(sf)) apply_frame(shard, sf.frame, sf.mapped, sf.received, sf.parsed);
+}
 
-        if (n <= 0) continue;
+// a frame for a worker that stopped: nothing will drain its inbox
+static void handoff_lost(IngestShard& owner)
+{
+    static std::atomic<bool> logged{false};
+    g_m.handoff_dropped->inc();
+    if (!logged.exchange(true))
+        g_log.text(LogLevel::Error, "[INGEST] Worker ", std::to_string(owner.index) + " is gone, dropping its devices' frames");
+}
 
-        int dev = -1;
-        char type[16]{};
+static void hand_over(IngestShard& shard, IngestShard& owner, const ShardFrame& sf)
+{
+    g_m.handoffs->inc();
+    if (!owner.server.load())
+    {
+        handoff_lost(owner);
+        return;
+    }
+    if (owner.inbox.push(sf))
+    {
+        shard.wake_pending[owner.index] = 1;
+        return;
+    }
 
-        if (sscanf(buf, "DEV=%d,TYPE=%15[^,]", &dev, type) != 2)
+    // owner is behind: wake it now and keep our own inbox moving meanwhile
+    g_m.handoff_full->inc();
+    do
+    {
+        IngestServer* server = owner.server.load();
+        if (!server)
         {
-            std::cout << "[INGEST] Bad header: " << buf << "\n";
-            continue;
+            handoff_lost(owner);
+            return;
         }
+        server->wake();
+        drain_inbox(shard);
+        std::this_thread::yield();
+    } while (!owner.inbox.push(sf));
+    shard.wake_pending[owner.index] = 1;
+}
+
+static void handle_frame(IngestShard& shard, const IngestFrame& frame)
+{
+    Frame f;
+    auto parse_start = g_timed ? std::chrono::steady_clock::now() : frame.received;
+    ParseStatus st = parse_frame(frame.data, frame.len, f);
+    auto parsed = g_timed ? std::chrono::steady_clock::now() : frame.received;
+    if (g_timed) g_m.parse->observe_ns(elapsed_ns(parse_start, parsed));
+
+    if (st == ParseStatus::BadHeader)
+    {
+        g_m.bad_header->inc();
+        if (f.binary) g_log.text(LogLevel::Warn, "[INGEST] Bad binary frame header");
+        else g_log.text(LogLevel::Warn, "[INGEST] Bad header: ", std::string_view(frame.data, frame.len));
+        return;
+    }
+    if (st == ParseStatus::BadChecksum)
+    {
+        g_m.bad_crc->inc();
+        g_log.text(LogLevel::Warn, "[INGEST] Bad CRC on binary frame");
+        return;
+    }
+    if (st == ParseStatus::UnknownType && !f.binary && g_map.find_type(f.type_name) >= 0)
+        st = ParseStatus::Ok;   // a TYPE only the point map knows
+
+    if (st == ParseStatus::UnknownType)
+    {
+        g_m.unknown_type->inc();
+        g_log.text(LogLevel::Warn, "[INGEST] Unknown TYPE=", f.type_name);
+        return;
+    }
+    if (st != ParseStatus::Ok)
+    {
+        g_m.missing_field->inc();
+        return;
+    }
+
+    if (f.type == FrameType::Passcode)
+    {
+        g_m.passcode->inc();
+        g_log.text(LogLevel::Info, f.passcode_ok ? "PASSCODE CORRECT" : "PASSCODE INCORRECT");
+        return;
+    }
+
+    if (f.dev < 0 || static_cast<size_t>(f.dev) >= g_device_count)
+    {
+        g_m.bad_dev->inc();
+        char msg[64];
+        int n = snprintf(msg, sizeof(msg), "[INGEST] DEV=%d outside 0..%zu", f.dev, g_device_count - 1);
+        g_log.text(LogLevel::Warn, std::string_view(msg, std::max(n, 0)));
+        return;
+    }
+
+    MappedFrame m;
+    if (!g_map.dispatch(f, m))
+    {
+        g_m.unknown_type->inc();
+        g_log.text(LogLevel::Warn, "[INGEST] TYPE not in the point map: ", f.type_name);
+        return;
+    }
+    if (m.count == 0)
+    {
+        g_m.missing_field->inc();
+        return;
+    }
+
+    IngestShard& owner = shard_of(f.dev);
+    if (&owner != &shard)
+    {
+        // the receive buffer is reused as soon as this returns
+        f.type_name = frame_type_name(f.type);
+        f.field_count = 0;
+        hand_over(shard, owner, ShardFrame{ f, m, frame.received, parsed });
+        return;
+    }
+
+    apply_frame(shard, f, m, frame.received, parsed);
+}
+
+// The firmware's own types keep their compact log records; TYPEs only the
+// map knows are logged as "[TYPE] FIELD=v ... DEV=n" from the mapped values.
+static void log_frame(const Frame& f, const MappedFrame& m)
+{
+    switch (f.type)
+    {
+    case FrameType::Env:    g_log.env(f.dev, f.temp, f.hum);         return;
+    case FrameType::Keypad: g_log.keypad(f.dev, f.key);              return;
+    case FrameType::Sensor: g_log.motion(f.dev, f.state);            return;
+    case FrameType::Rotary: g_log.rotary(f.dev, f.left, f.right);    return;
+    default:                break;
+    }
+    if (!g_log.enabled(LogLevel::Info)) return;
+
+    char line[AsyncLog::TEXT_MAX];
+    size_t used = 0;
+    auto append = [&](int n) { used = std::min(used + std::max(n, 0), sizeof(line) - 1); };
+
+    append(snprintf(line, sizeof(line), "[%s]", g_map.type_name(m.type_id).c_str()));
+    for (size_t i = 0; i < m.count; ++i)
+    {
+        append(snprintf(line + used, sizeof(line) - used, " %s=%g",
+                        g_map.route(m.values[i].route).field.c_str(), m.values[i].value));
+    }
+    append(snprintf(line + used, sizeof(line) - used, " DEV=%d", f.dev));
+    g_log.text(LogLevel::Info, std::string_view(line, used));
+}
+
+// owner shard only, for frames it received itself or was handed
+static void apply_frame(IngestShard& shard, const Frame& f, const MappedFrame& m,
+                        std::chrono::steady_clock::time_point received,
+                        std::chrono::steady_clock::time_point parsed)
+{
+    // UDP may deliver a datagram twice and devices resend their last frames
+    // after a reconnect; never apply the same reading again
+    if (f.has_seq && !g_seq.observe(f.dev, f.seq, f.time_ms))
+    {
+        g_m.duplicate->inc();
+        return;
+    }
+
+    DeviceState d = g_devices.load(f.dev);
+    uint64_t now_ms = wall_clock_ms();
+
+    // history, rollups and DNP3 events carry the time the device sampled
+    // the value (TS= or binary time) when its clock is synced
+    bool stamped = device_time_ok(f, now_ms);
+    uint64_t time_ms = stamped ? f.time_ms : now_ms;
+
+    bool event = false;
+    for (size_t i = 0; i < m.count; ++i)
+    {
+        const MappedValue& v = m.values[i];
+        const PointRoute& r = g_map.route(v.route);
 
-        std::lock_guard<std::mutex> lock(g_mutex);
+        // every frame of an event=every point is an event, a change of an soe one
+        if (r.every || (r.soe && (v.route >= DEVICE_VALUES || d.values[v.route] != v.value))) event = true;
+        if (v.route < DEVICE_VALUES) d.values[v.route] = v.value;
+        if (g_history) g_history->append(f.dev, r.history_point, time_ms, v.value, HISTORY_QUALITY);
+        if (r.rollup) g_rollups->add(f.dev, r.history_point, time_ms, v.value);
+    }
+    log_frame(f, m);
+
+    d.type = m.type_id;
+    d.seen = true;
+    if (event) d.events++;
+    d.last_update = std::chrono::steady_clock::now();
+    g_devices.store(f.dev, d);
+    g_m.accepted[m.type_id]->inc();
+    if (g_timed) g_m.state_write->observe_ns(elapsed_ns(d.last_update, std::chrono::steady_clock::now()));
+
+    if (g_tracing)
+    {
+        g_trace.receive_to_parse.record(elapsed_ns(received, parsed));
+        g_trace.parse_to_commit.record(elapsed_ns(parsed, d.last_update));
+        if (stamped)
+            g_trace.capture_to_receive.record((static_cast<int64_t>(now_ms) - static_cast<int64_t>(f.time_ms)) * 1000000);
+    }
+
+    shard.publisher->publish(f.dev, m, time_ms, f.has_seq, f.seq, d.last_update);
+    shard.publisher->publish_online(f.dev, true);
+}
+
+// ONLINE of the devices this shard owns, on its own thread: ingest sets it
+// here too, so a frame that just arrived is never overwritten by an older read
+static void check_online(IngestShard& shard)
+{
+    auto now = std::chrono::steady_clock::now();
+    for (size_t dev = shard.index; dev < g_device_count; dev += g_shards.size())
+    {
+        DeviceState d = g_devices.load(dev);
+        if (!d.seen) continue;
+
+        bool online =
+            std::chrono::duration_cast<std::chrono::seconds>(
+                now - d.last_update
+            ).count() < ONLINE_TIMEOUT_S;
+
+        shard.publisher->publish_online(dev, online);
+    }
+}
+
+static void on_wake(IngestShard& shard)
+{
+    drain_inbox(shard);
+    if (shard.online_due.exchange(false)) check_online(shard);
+}
+
+// Before every epoll_wait: wake the owners of frames handed over in this
+// round (one eventfd write per owner, not per frame), then run the
+// coalescing deadline of this shard's DNP3 batch.
+static int shard_timer(IngestShard& shard)
+{
+    for (size_t i = 0; i < shard.wake_pending.size(); ++i)
+    {
+        if (!shard.wake_pending[i]) continue;
+        shard.wake_pending[i] = 0;
+        if (IngestServer* server = g_shards[i]->server.load()) server->wake();
+    }
+    return shard.publisher->flush_due();
+}
+
+static void ingest_thread(IngestShard& shard, uint16_t port, uint16_t udp_port)
+{
+    IngestServer server(port, [&shard](const IngestFrame& f) { handle_frame(shard, f); });
+    server.set_reuse_port(g_shards.size() > 1);
+
+    bool opened = server.open();
+    if (opened && server.open_udp(udp_port) && shard.index == 0)
+        g_log.text(LogLevel::Info, "[INGEST] UDP on ", std::to_string(udp_port));
+
+    server.set_timer([&shard] { return shard_timer(shard); });
+    server.set_wake_handler([&shard] { on_wake(shard); });
+    if (opened) shard.server.store(&server);
+    else g_shards_failed.fetch_add(1);
+
+    // no handoffs until every worker can be woken
+    g_shards_ready.fetch_add(1);
+    while (g_shards_ready.load() < g_shards.size())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (!opened) return;
+
+    if (shard.index == 0)
+    {
+        g_log.text(LogLevel::Info, "[INGEST] Listening on ", std::to_string(port) + " (" +
+                   std::to_string(g_shards.size()) + " workers)");
+    }
+    drain_inbox(shard);
+    server.run();
+    shard.server.store(nullptr);
+}
+
+template <class F>
+static uint64_t sum_shards(F read)
+{
+    uint64_t total = 0;
+    for (const auto& shard : g_shards) total += read(*shard);
+    return total;
+}
 
-        if (strcmp(type, "ENV") == 0)
+static void print_publish_stats()
+{
+    uint64_t frames  = sum_shards([](IngestShard& s) { return s.publisher->stats().frames.load(); });
+    uint64_t batches = sum_shards([](IngestShard& s) { return s.publisher->stats().batches.load(); });
+    uint64_t points  = sum_shards([](IngestShard& s) { return s.publisher->stats().points.load(); });
+    uint64_t max_batch = 0;
+    for (const auto& shard : g_shards)
+        max_batch = std::max<uint64_t>(max_batch, shard->publisher->stats().max_batch.load());
+
+    std::cout << "[DNP3] frames=" << frames
+              << " applies=" << batches
+              << " avg_batch=" << (batches ? double(points) / batches : 0.0)
+              << " max_batch=" << max_batch
+              << " coalesced=" << sum_shards([](IngestShard& s) { return s.publisher->stats().coalesced.load(); })
+              << " applies_saved=" << (frames > batches ? frames - batches : 0) << "\n";
+
+    uint64_t edges = sum_shards([](IngestShard& s) { return s.publisher->stats().soe_events.load(); });
+    if (edges)
+    {
+        std::cout << "[SOE] edges=" << edges
+                  << " reordered=" << sum_shards([](IngestShard& s) { return s.publisher->stats().soe_reordered.load(); })
+                  << " ring_full=" << sum_shards([](IngestShard& s) { return s.publisher->stats().soe_full.load(); })
+                  << "\n";
+    }
+
+    if (g_shards.size() > 1)
+    {
+        std::cout << "[INGEST] workers=" << g_shards.size()
+                  << " handoffs=" << g_m.handoffs->value()
+                  << " inbox_full=" << g_m.handoff_full->value() << "\n";
+    }
+}
+
+// DNP3 channel bytes per second over the last stats period, the number
+// to compare when tuning classes, deadbands and variations in the map
+static void print_link_stats(const LinkStatistics& link)
+{
+    static size_t last_tx = 0, last_rx = 0;
+
+    std::cout << "[LINK] tx=" << (link.channel.numBytesTx - last_tx) / STATS_PERIOD_S
+              << " B/s rx=" << (link.channel.numBytesRx - last_rx) / STATS_PERIOD_S
+              << " B/s total_tx=" << link.channel.numBytesTx << "\n";
+    last_tx = link.channel.numBytesTx;
+    last_rx = link.channel.numBytesRx;
+}
+
+static void print_mqtt_stats()
+{
+    if (!g_mqtt) return;
+
+    const MqttStats& st = g_mqtt->stats();
+    std::cout << "[MQTT] connected=" << g_mqtt->connected()
+              << " published=" << st.published.load()
+              << " delivered=" << st.delivered.load()
+              << " failed=" << st.failed.load()
+              << " enabled:";
+    for (size_t t = 0; t < g_map.types(); ++t)
+    {
+        int e = g_mqtt->enabled(t);
+        std::cout << " " << g_map.mqtt_name(t) << "=" << (e < 0 ? "?" : e ? "on" : "off");
+    }
+    std::cout << "\n";
+
+    const CommandTrace& trace = g_mqtt->command_trace();
+    if (st.commands.load() == 0) return;
+    std::cout << "[CMD] commands=" << st.commands.load()
+              << " acked=" << st.command_acks.load()
+              << " broker p50=" << trace.to_broker.percentile(0.50) / 1000000.0
+              << " ms ack p50=" << trace.to_ack.percentile(0.50) / 1000000.0
+              << " ms p99=" << trace.to_ack.percentile(0.99) / 1000000.0 << " ms\n";
+}
+
+// per-device sequence counters, only for devices that send SEQ
+static void print_seq_stats()
+{
+    uint64_t datagrams = sum_shards([](IngestShard& s) {
+        IngestServer* server = s.server.load();
+        return server ? server->udp_datagrams() : 0;
+    });
+    uint64_t batches = sum_shards([](IngestShard& s) {
+        IngestServer* server = s.server.load();
+        return server ? server->udp_batches() : 0;
+    });
+    if (datagrams)
+    {
+        std::cout << "[UDP] datagrams=" << datagrams
+                  << " per_recvmmsg=" << double(datagrams) / batches << "\n";
+    }
+
+    for (size_t dev = 0; dev < g_device_count; ++dev)
+    {
+        const SeqCounters& c = g_seq.counters(dev);
+        if (!c.received.load()) continue;
+
+        std::cout << "[SEQ] DEV=" << dev
+                  << " received=" << c.received.load()
+                  << " lost=" << c.lost.load()
+                  << " dup=" << c.duplicates.load()
+                  << " late=" << c.reordered.load()
+                  << " restarts=" << c.restarts.load() << "\n";
+    }
+}
+
+// last complete bucket of every rollup window, for devices that sent
+// the points the map marks `rollup`
+static void print_rollups()
+{
+    uint64_t now = wall_clock_ms();
+    const auto& windows = g_rollups->windows();
+
+    for (size_t dev = 0; dev < g_device_count; ++dev)
+    {
+        for (const PointRoute& route : g_map.routes())
         {
-            float t, h;
-            if (sscanf(buf,
-                "DEV=%*d,TYPE=ENV,TEMP=%f,HUM=%f", &t, &h) == 2)
+            if (!route.rollup) continue;
+            uint16_t point = route.history_point;
+
+            std::ostringstream line;
+            for (size_t w = 0; w < windows.size(); ++w)
             {
-                g_state.temp = t;
-                g_state.hum  = h;
-                g_state.last_update = std::chrono::steady_clock::now();
-                std::cout << "[ENV] T=" << t << " H=" << h << "\n";
+                uint64_t width = windows[w].width.count();
+                uint64_t start = (now / width - 1) * width;
+                Rollup r = g_rollups->summary(dev, point, w, start, start);
+                if (!r.count) continue;
+
+                if (width % 3600000 == 0) line << " " << width / 3600000 << "h";
+                else                      line << " " << width / 60000 << "m";
+                line << " min=" << r.min << " mean=" << r.mean() << " max=" << r.max << " n=" << r.count;
             }
-        }
-        else if (strcmp(type, "KEYPAD") == 0)
-        {
-            char key;
-            if (sscanf(buf,
-                "DEV=%*d,TYPE=KEYPAD,KEY=%c", &key) == 1)
+
+            if (line.tellp() > 0)
             {
-                g_state.keypad = key_to_counter(key);
-                g_state.last_update = std::chrono::steady_clock::now();
-                std::cout << "[KEYPAD] key=" << key << "\n";
+                std::cout << "[ROLLUP] DEV=" << dev << " " << route.field << line.str() << "\n";
             }
         }
-        else if (strcmp(type, "SENSOR") == 0)
-        {
-        	int HrStatus;
-        	if(sscanf(buf, "DEV=%*d,TYPE=SENSOR,GPIO=%*d,STATE=%d", &HrStatus) == 1)
-        	{
-        		g_state.HrStatusSt = HrStatus;
-        		g_state.last_update = std::chrono::steady_clock::now();
-        		std::cout << "[HCSR501] STATE: " << HrStatus << "\n";
-        	}
-        }
-        else if (strcmp(type, "ROTARY") == 0)
-        {
-        	int L_ac, R_ac;
-        	if(sscanf(buf, "DEV=%*d,TYPE=ROTARY,L=%d,R=%d", &L_ac, &R_ac) == 2)
-        	{
-        		g_state.Left_ac = L_ac;
-        		g_state.Right_ac = R_ac;
-        		g_state.last_update = std::chrono::steady_clock::now();
-        		std::cout << "[ROTARY] LEFT ACTIVE: " << L_ac << " RIGHT ACTIVE: " << R_ac << "\n";
-        		
-        	}
-        	
-        }
-        else if (strcmp(type, "T") == 0)
-        {
-        	if (sscanf(buf, "PASSCODE_CORRECT") == 1)
-        	{
-        		std::cout << "PASSCODE CORRECT" << "\n";
-        	}
-        	else
-        	{
-        		std::cout << "PASSCODE INCORRECT" << "\n";
-        	}
-        }
-       	
-        
-        else
+    }
+}
+
+static void print_trace()
+{
+    if (!g_tracing)
+    {
+        std::cout << "[TRACE] Tracing is off, start with GATEWAY_TRACE=1\n";
+        return;
+    }
+
+    std::cout << std::flush;
+    g_trace.capture_to_receive.print("[TRACE]", "capture->receive");
+    g_trace.receive_to_parse.print("[TRACE]", "receive->parse");
+    g_trace.parse_to_commit.print("[TRACE]", "parse->commit");
+    g_publish_trace.commit_to_apply.print("[TRACE]", "commit->apply");
+    g_publish_trace.apply.print("[TRACE]", "apply call");
+    fflush(stdout);
+}
+
+static void reset_trace()
+{
+    g_trace.capture_to_receive.reset();
+    g_trace.receive_to_parse.reset();
+    g_trace.parse_to_commit.reset();
+    g_publish_trace.commit_to_apply.reset();
+    g_publish_trace.apply.reset();
+    std::cout << "[TRACE] Histograms cleared\n";
+}
+
+static void register_metrics()
+{
+    auto accepted = [](const std::string& type) {
+        return &g_metrics.counter("gateway_frames_accepted_total",
+                                  "Frames applied to the device table (PASSCODE: logged only)",
+                                  "type=\"" + type + "\"");
+    };
+    for (size_t t = 0; t < g_map.types(); ++t) g_m.accepted.push_back(accepted(g_map.type_name(t)));
+    g_m.passcode = accepted("PASSCODE");
+
+    auto rejected = [](const char* reason) {
+        return &g_metrics.counter("gateway_frames_rejected_total", "Frames dropped before the device table",
+                                  std::string("reason=\"") + reason + "\"");
+    };
+    g_m.bad_header    = rejected("bad_header");
+    g_m.bad_crc       = rejected("bad_crc");
+    g_m.unknown_type  = rejected("unknown_type");
+    g_m.missing_field = rejected("missing_field");
+    g_m.bad_dev       = rejected("dev_out_of_range");
+    g_m.duplicate     = rejected("duplicate_seq");
+
+    g_m.parse = &g_metrics.histogram("gateway_parse_seconds", "parse_frame() time per frame");
+    g_m.state_write = &g_metrics.histogram(
+        "gateway_state_write_seconds", "Device table seqlock write section, readers retry while it is open");
+    g_m.apply = &g_metrics.histogram("gateway_dnp3_apply_seconds", "Duration of one batched outstation Apply()");
+    g_m.handoffs = &g_metrics.counter("gateway_shard_handoffs_total",
+                                      "Frames parsed by one ingest worker for a device owned by another");
+    g_m.handoff_full = &g_metrics.counter("gateway_shard_handoff_full_total",
+                                          "Handoffs that had to wait for a full owner inbox");
+    g_m.handoff_dropped = &g_metrics.counter("gateway_shard_handoff_dropped_total",
+                                             "Handoffs dropped because the owning worker is not running");
+
+    g_metrics.gauge_fn("gateway_connected_clients", "Open TCP ingest sessions", "", [] {
+        return double(sum_shards([](IngestShard& s) {
+            IngestServer* server = s.server.load();
+            return server ? server->connections() : 0;
+        }));
+    });
+    g_metrics.counter_fn("gateway_udp_datagrams_total", "UDP datagrams received", "", [] {
+        return double(sum_shards([](IngestShard& s) {
+            IngestServer* server = s.server.load();
+            return server ? server->udp_datagrams() : 0;
+        }));
+    });
+    g_metrics.counter_fn("gateway_truncated_frames_total", "Unterminated tails of framed TCP sessions, dropped at close", "", [] {
+        return double(sum_shards([](IngestShard& s) {
+            IngestServer* server = s.server.load();
+            return server ? server->truncated_frames() : 0;
+        }));
+    });
+    g_metrics.counter_fn("gateway_dnp3_applies_total", "Apply() calls made by the publishers", "", [] {
+        return double(sum_shards([](IngestShard& s) { return s.publisher->stats().batches.load(); }));
+    });
+    g_metrics.counter_fn("gateway_dnp3_points_total", "Points applied to the outstation", "", [] {
+        return double(sum_shards([](IngestShard& s) { return s.publisher->stats().points.load(); }));
+    });
+    g_metrics.counter_fn("gateway_dnp3_soe_events_total", "Edges applied as their own timestamped event", "", [] {
+        return double(sum_shards([](IngestShard& s) { return s.publisher->stats().soe_events.load(); }));
+    });
+    g_metrics.counter_fn("gateway_log_dropped_total", "Log records dropped because the ring was full", "",
+                         [] { return double(g_log.dropped()); });
+
+    // only devices that have reported at least once
+    for (size_t dev = 0; dev < g_device_count; ++dev)
+    {
+        g_metrics.gauge_fn("gateway_device_staleness_seconds", "Seconds since the device last sent a frame",
+                           "dev=\"" + std::to_string(dev) + "\"", [dev] {
+            DeviceState d = g_devices.load(dev);
+            if (!d.seen) return std::nan("");
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - d.last_update).count();
+        });
+    }
+}
+
+static void register_mqtt_metrics()
+{
+    const MqttStats& st = g_mqtt->stats();
+    g_metrics.gauge_fn("gateway_mqtt_connected", "1 while the MQTT broker is connected", "",
+                       [] { return double(g_mqtt->connected()); });
+    g_metrics.counter_fn("gateway_mqtt_published_total", "State messages published", "",
+                         [&st] { return double(st.published.load()); });
+    g_metrics.counter_fn("gateway_mqtt_delivered_total", "State messages written (QoS 0) or acknowledged", "",
+                         [&st] { return double(st.delivered.load()); });
+    g_metrics.counter_fn("gateway_mqtt_failed_total", "State publishes refused by the client", "",
+                         [&st] { return double(st.failed.load()); });
+
+    // last enable state heard for each sensor, NaN (left out) until then
+    for (size_t t = 0; t < g_map.types(); ++t)
+    {
+        g_metrics.gauge_fn("gateway_sensor_enabled", "Sensor enable switch from MQTT cmd/status",
+                           "sensor=\"" + g_map.mqtt_name(t) + "\"", [t] {
+                               int e = g_mqtt->enabled(t);
+                               return e < 0 ? std::nan("") : double(e);
+                           });
+    }
+
+    g_metrics.counter_fn("gateway_commands_total", "DNP3 enable commands sent to MQTT", "",
+                         [&st] { return double(st.commands.load()); });
+    g_metrics.counter_fn("gateway_command_acks_total", "Enable commands confirmed by the device status", "",
+                         [&st] { return double(st.command_acks.load()); });
+    g_mqtt->set_ack_metric(&g_metrics.histogram("gateway_command_ack_seconds",
+                                                "DNP3 operate to matching device status", "",
+                                                {0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10}));
+}
+
+/* -------------------- DNP3 CONTROLS --------------------
+ * A CROB on binary output k (the control= of a point map mqtt line)
+ * switches that sensor TYPE on or off through MQTT, the same switch
+ * masterLCD.py flips: LATCH_ON, PULSE_ON or CLOSE enable, LATCH_OFF,
+ * PULSE_OFF or TRIP disable. Operate() only queues the publish, so the
+ * DNP3 thread never waits on the broker and the master gets SUCCESS once
+ * the command is on its way; the device's .../status report then updates
+ * binary output status k, which the master sees as a class 1 event.
+ */
+
+class EnableCommandHandler final : public ICommandHandler
+{
+public:
+    void Begin() override {}
+    void End() override {}
+
+    CommandStatus Select(const ControlRelayOutputBlock& crob, uint16_t index) override
+    {
+        int type = g_map.find_control(index);
+        if (type < 0 || to_enable(crob) < 0) return CommandStatus::NOT_SUPPORTED;
+        return g_mqtt && g_mqtt->connected() ? CommandStatus::SUCCESS : CommandStatus::HARDWARE_ERROR;
+    }
+
+    CommandStatus Operate(const ControlRelayOutputBlock& crob, uint16_t index, IUpdateHandler&, OperateType) override
+    {
+        int type = g_map.find_control(index);
+        int enable = to_enable(crob);
+        if (type < 0 || enable < 0) return CommandStatus::NOT_SUPPORTED;
+        if (!g_mqtt || !g_mqtt->send_command(static_cast<size_t>(type), enable == 1))
+            return CommandStatus::HARDWARE_ERROR;
+
+        g_log.text(LogLevel::Info, "[CMD] BO" + std::to_string(index) + " " + g_map.mqtt_name(type) +
+                                       (enable ? " enable" : " disable") + " sent");
+        return CommandStatus::SUCCESS;
+    }
+
+    // no analog outputs
+    CommandStatus Select(const AnalogOutputInt16&, uint16_t) override { return CommandStatus::NOT_SUPPORTED; }
+    CommandStatus Operate(const AnalogOutputInt16&, uint16_t, IUpdateHandler&, OperateType) override { return CommandStatus::NOT_SUPPORTED; }
+    CommandStatus Select(const AnalogOutputInt32&, uint16_t) override { return CommandStatus::NOT_SUPPORTED; }
+    CommandStatus Operate(const AnalogOutputInt32&, uint16_t, IUpdateHandler&, OperateType) override { return CommandStatus::NOT_SUPPORTED; }
+    CommandStatus Select(const AnalogOutputFloat32&, uint16_t) override { return CommandStatus::NOT_SUPPORTED; }
+    CommandStatus Operate(const AnalogOutputFloat32&, uint16_t, IUpdateHandler&, OperateType) override { return CommandStatus::NOT_SUPPORTED; }
+    CommandStatus Select(const AnalogOutputDouble64&, uint16_t) override { return CommandStatus::NOT_SUPPORTED; }
+    CommandStatus Operate(const AnalogOutputDouble64&, uint16_t, IUpdateHandler&, OperateType) override { return CommandStatus::NOT_SUPPORTED; }
+
+private:
+    // 1 enable, 0 disable, -1 not a switch
+    static int to_enable(const ControlRelayOutputBlock& crob)
+    {
+        if (crob.tcc == TripCloseCode::CLOSE) return 1;
+        if (crob.tcc == TripCloseCode::TRIP) return 0;
+        switch (crob.opType)
         {
-            std::cout << "[INGEST] Unknown TYPE=" << type << "\n";
+        case OperationType::LATCH_ON:
+        case OperationType::PULSE_ON:  return 1;
+        case OperationType::LATCH_OFF:
+        case OperationType::PULSE_OFF: return 0;
+        default:                       return -1;
         }
     }
-}
+};
 
 /* -------------------- MAIN -------------------- */
 
-int main()
+// class=, svar= and evar= of a point map line as opendnp3 settings;
+// the map has already rejected variations outside these lists
+static PointClass point_class(uint8_t event_class)
+{
+    switch (event_class)
+    {
+    case 0:  return PointClass::Class0;
+    case 2:  return PointClass::Class2;
+    case 3:  return PointClass::Class3;
+    default: return PointClass::Class1;
+    }
+}
+
+static BinaryConfig binary_config(const PointRoute& r)
+{
+    BinaryConfig c;
+    c.clazz = point_class(r.event_class);
+    c.svariation = r.static_var == 1 ? StaticBinaryVariation::Group1Var1 : StaticBinaryVariation::Group1Var2;
+    switch (r.event_var)
+    {
+    case 1:  c.evariation = EventBinaryVariation::Group2Var1; break;
+    case 3:  c.evariation = EventBinaryVariation::Group2Var3; break;
+    default: c.evariation = EventBinaryVariation::Group2Var2; break;
+    }
+    return c;
+}
+
+static AnalogConfig analog_config(const PointRoute& r)
+{
+    static const StaticAnalogVariation statics[] = {
+        StaticAnalogVariation::Group30Var1, StaticAnalogVariation::Group30Var2, StaticAnalogVariation::Group30Var3,
+        StaticAnalogVariation::Group30Var4, StaticAnalogVariation::Group30Var5, StaticAnalogVariation::Group30Var6
+    };
+    static const EventAnalogVariation events[] = {
+        EventAnalogVariation::Group32Var1, EventAnalogVariation::Group32Var2, EventAnalogVariation::Group32Var3,
+        EventAnalogVariation::Group32Var4, EventAnalogVariation::Group32Var5, EventAnalogVariation::Group32Var6,
+        EventAnalogVariation::Group32Var7, EventAnalogVariation::Group32Var8
+    };
+
+    AnalogConfig c;
+    c.clazz = point_class(r.event_class);
+    c.svariation = statics[r.static_var - 1];
+    c.evariation = events[r.event_var - 1];
+    c.deadband = r.deadband;
+    return c;
+}
+
+static CounterConfig counter_config(const PointRoute& r)
+{
+    CounterConfig c;
+    c.clazz = point_class(r.event_class);
+    switch (r.static_var)
+    {
+    case 2:  c.svariation = StaticCounterVariation::Group20Var2; break;
+    case 5:  c.svariation = StaticCounterVariation::Group20Var5; break;
+    case 6:  c.svariation = StaticCounterVariation::Group20Var6; break;
+    default: c.svariation = StaticCounterVariation::Group20Var1; break;
+    }
+    switch (r.event_var)
+    {
+    case 1:  c.evariation = EventCounterVariation::Group22Var1; break;
+    case 2:  c.evariation = EventCounterVariation::Group22Var2; break;
+    case 6:  c.evariation = EventCounterVariation::Group22Var6; break;
+    default: c.evariation = EventCounterVariation::Group22Var5; break;
+    }
+    c.deadband = static_cast<uint32_t>(r.deadband);
+    return c;
+}
+
+int main(int argc, char** argv)
 {
+    g_log.set_level(parse_log_level(getenv("GATEWAY_LOG_LEVEL"), LogLevel::Info));
+    g_log.start(stdout);
+
+    const char* trace = getenv("GATEWAY_TRACE");
+    g_tracing = trace && strcmp(trace, "0") != 0;
+    std::signal(SIGUSR1, [](int) { g_trace_dump = 1; });
+    std::signal(SIGUSR2, [](int) { g_trace_reset = 1; });
+
+    const char* map_path = getenv("GATEWAY_POINT_MAP");
+    std::string map_error;
+    if (g_map.load(map_path ? map_path : "pointmap.conf", map_error))
+    {
+        std::cout << "[MAP] " << (map_path ? map_path : "pointmap.conf") << ": " << g_map.routes().size()
+                  << " points, " << g_map.types() << " types\n";
+    }
+    else
+    {
+        std::cout << "[MAP] " << map_error << ", using the built-in map\n";
+    }
+
+    BatchConfig batch;
+    size_t max_devices = std::min(MAX_DEVICES, g_map.max_devices());
+    g_device_count = std::min(g_device_count, max_devices);
+    if (argc > 1)
+        g_device_count = std::clamp<size_t>(strtoul(argv[1], nullptr, 10), 1, max_devices);
+    if (argc > 2)
+        batch.window = std::chrono::milliseconds(strtoul(argv[2], nullptr, 10));
+    if (argc > 3)
+        batch.max_changes = std::max<size_t>(1, strtoul(argv[3], nullptr, 10));
+
     DNP3Manager manager(1);
 
     auto channel = manager.AddTCPServer(
@@ -160,54 +887,232 @@ int main()
         PrintingChannelListener::Create()
     );
 
+    // ONLINE is class 1 with absolute time, like every event the master
+    // uses to measure latency
+    BinaryConfig online;
+    online.evariation = EventBinaryVariation::Group2Var2;
+
+    // one index block per device, laid out by the point map, with each
+    // point's class, deadband and variations
     OutstationStackConfig config;
-    config.database.analog_input[0] = AnalogConfig();   // TEMP
-    config.database.analog_input[1] = AnalogConfig();   // HUM
-    config.database.binary_input[0] = BinaryConfig();   // ONLINE
-    config.database.counter[0]      = CounterConfig();  // KEYPAD
-    config.database.analog_input[2] = AnalogConfig();   // MOTION SENSOR
-    config.database.analog_input[3] = AnalogConfig(); 	// Left Active -> Rotary Encoder
-    config.database.analog_input[4] = AnalogConfig(); 	// Right Active -> Rotary Encoder
-    
+    for (size_t dev = 0; dev < g_device_count; ++dev)
+    {
+        config.database.binary_input[g_map.online_index(dev)] = online;
+
+        for (const PointRoute& r : g_map.routes())
+        {
+            uint16_t index = g_map.index(dev, r);
+            switch (r.kind)
+            {
+            case PointKind::Binary:  config.database.binary_input[index] = binary_config(r); break;
+            case PointKind::Analog:  config.database.analog_input[index] = analog_config(r); break;
+            case PointKind::Counter: config.database.counter[index] = counter_config(r);     break;
+            }
+        }
+    }
+
+    // binary output status k mirrors the enable switch of the TYPE with control=k
+    BOStatusConfig control;
+    control.clazz = PointClass::Class1;
+    control.evariation = EventBinaryOutputStatusVariation::Group11Var2;
+    size_t controls = 0;
+    for (size_t t = 0; t < g_map.types(); ++t)
+    {
+        if (g_map.control(t) < 0) continue;
+        config.database.binary_output_status[static_cast<uint16_t>(g_map.control(t))] = control;
+        ++controls;
+    }
+
+    // room for every device's events while the master is away; beyond
+    // that opendnp3 drops the oldest and sets the overflow IIN bit
+    EventBufferConfig& events = config.outstation.eventBufferSizes;
+    events.maxBinaryEvents  = static_cast<uint16_t>(g_map.event_buffer(PointKind::Binary, g_device_count));
+    events.maxAnalogEvents  = static_cast<uint16_t>(g_map.event_buffer(PointKind::Analog, g_device_count));
+    events.maxCounterEvents = static_cast<uint16_t>(g_map.event_buffer(PointKind::Counter, g_device_count));
+    events.maxBinaryOutputStatusEvents = static_cast<uint16_t>(std::max<size_t>(controls * 4, 1));
+
+    // report class 1/2/3 events unsolicited as soon as they are applied
+    config.outstation.params.allowUnsolicited = true;
 
     auto outstation = channel->AddOutstation(
         "station",
-        std::make_shared<SimpleCommandHandler>(CommandStatus::SUCCESS),
+        std::make_shared<EnableCommandHandler>(),
         std::make_shared<DefaultOutstationApplication>(),
         config
     );
 
+    size_t workers = 1;
+    if (const char* n = getenv("GATEWAY_INGEST_WORKERS"))
+        workers = std::clamp<size_t>(strtoul(n, nullptr, 10), 1, MAX_INGEST_WORKERS);
+
+    // one publisher per ingest worker, each only ever sees its own devices
+    for (size_t i = 0; i < workers; ++i)
+    {
+        auto shard = std::make_unique<IngestShard>();
+        shard->index = i;
+        shard->wake_pending.assign(workers, 0);
+        shard->publisher = std::make_unique<Dnp3Publisher>(outstation, g_map, g_device_count, batch);
+        shard->publisher->set_tracing(g_tracing ? &g_publish_trace : nullptr);
+        g_shards.push_back(std::move(shard));
+    }
+
+    register_metrics();
+    g_metrics.counter_fn("gateway_dnp3_link_bytes_total", "Bytes on the DNP3 channel", "dir=\"tx\"",
+                         [channel] { return double(channel->GetStatistics().channel.numBytesTx); });
+    g_metrics.counter_fn("gateway_dnp3_link_bytes_total", "Bytes on the DNP3 channel", "dir=\"rx\"",
+                         [channel] { return double(channel->GetStatistics().channel.numBytesRx); });
+    uint16_t metrics_port = METRICS_PORT;
+    if (const char* port = getenv("GATEWAY_METRICS_PORT"))
+        metrics_port = static_cast<uint16_t>(strtoul(port, nullptr, 10));
+
+    std::unique_ptr<MetricsServer> metrics;
+    if (metrics_port)
+    {
+        metrics = std::make_unique<MetricsServer>(g_metrics, metrics_port);
+        if (metrics->start())
+        {
+            for (const auto& shard : g_shards) shard->publisher->set_apply_metric(g_m.apply);
+            std::cout << "[METRICS] Serving http://0.0.0.0:" << metrics_port << "/metrics\n";
+        }
+        else
+        {
+            metrics.reset();
+        }
+    }
+    g_timed = metrics || g_tracing;
+
+    MqttConfig mqtt;
+    if (const char* host = getenv("GATEWAY_MQTT_HOST")) mqtt.host = host;
+    if (const char* port = getenv("GATEWAY_MQTT_PORT")) mqtt.port = static_cast<uint16_t>(strtoul(port, nullptr, 10));
+    if (const char* qos = getenv("GATEWAY_MQTT_QOS")) mqtt.qos = std::clamp(atoi(qos), 0, 2);
+    if (const char* ms = getenv("GATEWAY_MQTT_BATCH_MS"))
+        mqtt.batch = std::chrono::milliseconds(std::max<unsigned long>(1, strtoul(ms, nullptr, 10)));
+
+    if (mqtt.port)
+    {
+        g_mqtt = std::make_unique<MqttBridge>(g_devices, g_map, g_device_count, mqtt);
+
+        // every status report (a command's ack or a switch flipped elsewhere) updates its output status point
+        g_mqtt->set_status_listener([outstation](size_t type, bool enabled, int64_t ack_ns) {
+            int index = g_map.control(type);
+            if (index < 0) return;
+
+            UpdateBuilder builder;
+            builder.Update(BinaryOutputStatus(enabled, Flags(0x01), DNPTime(wall_clock_ms(), TimestampQuality::SYNCHRONIZED)), static_cast<uint16_t>(index));
+            outstation->Apply(builder.Build());
+
+            if (ack_ns >= 0)
+                g_log.text(LogLevel::Info, "[CMD] " + g_map.mqtt_name(type) + (enabled ? " enabled" : " disabled") +
+                                               ", ack in " + std::to_string(ack_ns / 1000000) + " ms");
+        });
+
+        if (g_mqtt->start())
+        {
+            std::cout << "[MQTT] Publishing state to " << mqtt.host << ":" << mqtt.port << " (QoS " << mqtt.qos
+                      << ", every " << mqtt.batch.count() << " ms)\n";
+            register_mqtt_metrics();
+        }
+        else
+        {
+            g_mqtt.reset();
+        }
+    }
+
     outstation->Enable();
-    std::cout << "[DNP3] Outstation on port 9000\n";
+    std::cout << "[DNP3] Outstation on port 9000, " << g_device_count << " device slots, "
+              << batch.window.count() << " ms / " << batch.max_changes << " point batches\n";
+    if (g_tracing)
+        std::cout << "[TRACE] Latency tracing on, kill -USR1 " << getpid() << " to print\n";
 
-    std::thread ingest(ingest_thread, 9100);
+    HistorianConfig hist;
+    if (const char* dir = getenv("GATEWAY_HISTORY_DIR")) hist.dir = dir;
+    g_history = std::make_unique<Historian>(hist);
+    if (g_history->open())
+    {
+        std::cout << "[HISTORY] Recording to " << hist.dir << "/ (" << g_history->segments()
+                  << " existing segments, up to " << hist.max_segments << " x "
+                  << hist.records_per_segment << " samples)\n";
+    }
+    else
+    {
+        g_history.reset();
+    }
+
+    // rebuild a week of rollups from disk so summaries survive a restart
+    std::vector<uint16_t> rollup_points;
+    for (const PointRoute& r : g_map.routes())
+        if (r.rollup) rollup_points.push_back(r.history_point);
 
-    while (true)
+    g_rollups = std::make_unique<RollupEngine>(g_device_count, rollup_points);
+    if (g_history && !rollup_points.empty())
     {
-        SensorState local;
+        // one pass over the segments, not a query per device and point
+        std::vector<bool> rolled(*std::max_element(rollup_points.begin(), rollup_points.end()) + 1u);
+        for (uint16_t point : rollup_points) rolled[point] = true;
+
+        auto started = std::chrono::steady_clock::now();
+        uint64_t now = wall_clock_ms();
+        uint64_t week = 7ull * 24 * 3600 * 1000;
+        size_t fed = 0;
+        size_t scanned = g_history->scan(now > week ? now - week : 0, now, [&](const HistorySample& s) {
+            if (s.dev >= g_device_count || s.point >= rolled.size() || !rolled[s.point]) return;
+            g_rollups->add(s.dev, s.point, s.time_ms, s.value);
+            ++fed;
+        });
+        auto took = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        std::cout << "[ROLLUP] Rebuilt from " << fed << " of " << scanned << " samples in the last week, "
+                  << took.count() << " ms\n";
+    }
+
+    std::vector<std::thread> ingest;
+    for (const auto& shard : g_shards)
+        ingest.emplace_back(ingest_thread, std::ref(*shard), 9100, 9101);
+
+    // a worker without a listener would leave every device it owns dark
+    while (g_shards_ready.load() < g_shards.size())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (size_t failed = g_shards_failed.load())
+    {
+        std::cout << "[INGEST] " << failed << " of " << g_shards.size()
+                  << " workers could not listen on 9100, exiting\n";
+        g_log.stop();
+        std::cout.flush();
+        std::_Exit(1);
+    }
+
+    // readings are applied by ingest as they arrive; this loop only notices
+    // devices that stopped reporting and reports batching stats
+    for (int tick = 1; ; ++tick)
+    {
+        // each owner checks its devices' ONLINE on its own thread
+        for (const auto& shard : g_shards)
         {
-            std::lock_guard<std::mutex> lock(g_mutex);
-            local = g_state;
+            shard->online_due.store(true);
+            if (IngestServer* server = shard->server.load()) server->wake();
+        }
+
+        if (tick % STATS_PERIOD_S == 0)
+        {
+            print_publish_stats();
+            print_link_stats(channel->GetStatistics());
+            print_mqtt_stats();
+            print_seq_stats();
+            print_rollups();
+        }
+
+        if (g_trace_dump)
+        {
+            g_trace_dump = 0;
+            print_trace();
+        }
+        if (g_trace_reset)
+        {
+            g_trace_reset = 0;
+            reset_trace();
         }
 
-        bool online =
-            std::chrono::duration_cast<std::chrono::seconds>(
-                std::chrono::steady_clock::now() - local.last_update
-            ).count() < 10;
-
-        UpdateBuilder b;
-        b.Update(Analog(local.temp), 0);
-        b.Update(Analog(local.hum),  1);
-        b.Update(Binary(online),     0);
-        b.Update(Counter(local.keypad), 0);
-        b.Update(Analog(local.HrStatusSt), 2);
-        b.Update(Analog(local.Left_ac), 3);
-        b.Update(Analog(local.Right_ac), 4);
-
-        outstation->Apply(b.Build());
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 
-    ingest.join();
+    for (auto& t : ingest) t.join();
 }
-
@@ -0,0 +1,312 @@
+#include "historian.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr char SEGMENT_MAGIC[8] = { 'S', 'C', 'A', 'D', 'A', 'H', 'S', 'T' };
+static constexpr uint32_t SEGMENT_VERSION = 1;
+static constexpr size_t HEADER_SIZE = 4096;
+static constexpr size_t RECORD_BYTES = sizeof(uint64_t) + sizeof(float) + 2 * sizeof(uint16_t) + sizeof(uint8_t);
+
+struct SegmentHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    uint64_t id;
+    std::atomic<uint64_t> count;      // published records, written last
+    std::atomic<uint64_t> min_time;
+    std::atomic<uint64_t> max_time;
+};
+static_assert(sizeof(SegmentHeader) <= HEADER_SIZE, "segment header must fit its page");
+
+struct Historian::Segment
+{
+    uint64_t id = 0;
+    std::string path;
+    int fd = -1;
+    void* base = nullptr;
+    size_t size = 0;
+    uint32_t capacity = 0;
+
+    SegmentHeader* hdr = nullptr;
+    uint64_t* time = nullptr;
+    float* value = nullptr;
+    uint16_t* dev = nullptr;
+    uint16_t* point = nullptr;
+    uint8_t* quality = nullptr;
+
+    ~Segment()
+    {
+        if (base) munmap(base, size);
+        if (fd >= 0) close(fd);
+    }
+
+    bool full() const { return hdr->count.load(std::memory_order_relaxed) >= capacity; }
+
+    bool map(uint32_t create_capacity);
+};
+
+static size_t segment_size(uint32_t capacity)
+{
+    return HEADER_SIZE + static_cast<size_t>(capacity) * RECORD_BYTES;
+}
+
+static std::string segment_path(const std::string& dir, uint64_t id)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/seg-%08llu.col", static_cast<unsigned long long>(id));
+    return dir + name;
+}
+
+// Maps an existing segment, or creates one when create_capacity != 0.
+bool Historian::Segment::map(uint32_t create_capacity)
+{
+    uint32_t records = create_capacity;
+    bool create = records != 0;
+    fd = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0644);
+    if (fd < 0) return false;
+
+    if (create)
+    {
+        if (ftruncate(fd, segment_size(records)) != 0) return false;
+    }
+    else
+    {
+        SegmentHeader h;
+        struct stat st;
+        if (pread(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h))) return false;
+        if (memcmp(h.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0 ||
+            h.version != SEGMENT_VERSION || h.capacity == 0)
+            return false;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < segment_size(h.capacity))
+            return false;
+        records = h.capacity;
+    }
+
+    capacity = records;
+    size = segment_size(records);
+    base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        base = nullptr;
+        return false;
+    }
+
+    char* p = static_cast<char*>(base);
+    hdr = reinterpret_cast<SegmentHeader*>(p);
+    p += HEADER_SIZE;
+    time = reinterpret_cast<uint64_t*>(p);    p += records * sizeof(uint64_t);
+    value = reinterpret_cast<float*>(p);      p += records * sizeof(float);
+    dev = reinterpret_cast<uint16_t*>(p);     p += records * sizeof(uint16_t);
+    point = reinterpret_cast<uint16_t*>(p);   p += records * sizeof(uint16_t);
+    quality = reinterpret_cast<uint8_t*>(p);
+
+    if (create)
+    {
+        memcpy(hdr->magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+        hdr->version = SEGMENT_VERSION;
+        hdr->capacity = capacity;
+        hdr->id = id;
+        hdr->count.store(0, std::memory_order_relaxed);
+        hdr->min_time.store(UINT64_MAX, std::memory_order_relaxed);
+        hdr->max_time.store(0, std::memory_order_relaxed);
+    }
+    else if (hdr->count.load(std::memory_order_relaxed) > records)
+    {
+        return false;
+    }
+    return true;
+}
+
+Historian::Historian(HistorianConfig config) : config_(std::move(config))
+{
+    config_.records_per_segment = std::max<uint32_t>(config_.records_per_segment, 1);
+    config_.max_segments = std::max<size_t>(config_.max_segments, 1);
+}
+
+Historian::~Historian() = default;
+
+bool Historian::open()
+{
+    if (mkdir(config_.dir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        std::cout << "[HISTORY] mkdir " << config_.dir << " failed: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    std::vector<uint64_t> ids;
+    if (DIR* d = opendir(config_.dir.c_str()))
+    {
+        while (dirent* e = readdir(d))
+        {
+            unsigned long long id;
+            char tail;
+            if (sscanf(e->d_name, "seg-%llu.co%c", &id, &tail) == 2 && tail == 'l')
+                ids.push_back(id);
+        }
+        closedir(d);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint64_t id : ids)
+    {
+        auto s = std::make_shared<Segment>();
+        s->id = id;
+        s->path = segment_path(config_.dir, id);
+        if (!s->map(0))
+        {
+            std::cout << "[HISTORY] Skipping unreadable segment " << s->path << "\n";
+            continue;
+        }
+        segments_.push_back(std::move(s));
+        next_id_ = id + 1;
+    }
+
+    while (segments_.size() > config_.max_segments)
+    {
+        unlink(segments_.front()->path.c_str());
+        segments_.erase(segments_.begin());
+    }
+
+    if (!segments_.empty() && !segments_.back()->full())
+        active_ = segments_.back().get();
+    return true;
+}
+
+std::shared_ptr<Historian::Segment> Historian::create_segment(uint64_t id)
+{
+    auto s = std::make_shared<Segment>();
+    s->id = id;
+    s->path = segment_path(config_.dir, id);
+    if (!s->map(config_.records_per_segment))
+    {
+        std::cout << "[HISTORY] Cannot create " << s->path << ": " << strerror(errno) << "\n";
+        unlink(s->path.c_str());
+        return nullptr;
+    }
+    return s;
+}
+
+bool Historian::rotate()
+{
+    auto s = create_segment(next_id_);
+    if (!s) return false;
+    ++next_id_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    segments_.push_back(s);
+    active_ = s.get();
+
+    // readers still holding the oldest segment keep its mapping alive
+    while (segments_.size() > config_.max_segments)
+    {
+        unlink(segments_.front()->path.c_str());
+        segments_.erase(segments_.begin());
+    }
+    return true;
+}
+
+bool Historian::append(uint16_t dev, uint16_t point, uint64_t time_ms, float value, uint8_t quality)
+{
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (!active_ || active_->full())
+    {
+        if (!rotate()) return false;
+    }
+
+    Segment& s = *active_;
+    uint64_t i = s.hdr->count.load(std::memory_order_relaxed);
+
+    s.time[i] = time_ms;
+    s.value[i] = value;
+    s.dev[i] = dev;
+    s.point[i] = point;
+    s.quality[i] = quality;
+
+    if (time_ms < s.hdr->min_time.load(std::memory_order_relaxed))
+        s.hdr->min_time.store(time_ms, std::memory_order_relaxed);
+    if (time_ms > s.hdr->max_time.load(std::memory_order_relaxed))
+        s.hdr->max_time.store(time_ms, std::memory_order_relaxed);
+
+    s.hdr->count.store(i + 1, std::memory_order_release);
+    appended_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+std::vector<std::shared_ptr<Historian::Segment>> Historian::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_;
+}
+
+size_t Historian::query(uint16_t dev, uint16_t point, uint64_t from_ms, uint64_t to_ms,
+                        const HistoryVisitor& visit) const
+{
+    size_t visited = 0;
+    for (const auto& s : snapshot())
+    {
+        uint64_t count = s->hdr->count.load(std::memory_order_acquire);
+        if (count == 0) continue;
+        if (s->hdr->max_time.load(std::memory_order_relaxed) < from_ms ||
+            s->hdr->min_time.load(std::memory_order_relaxed) > to_ms)
+            continue;
+
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            if (s->dev[i] != dev || s->point[i] != point) continue;
+            uint64_t t = s->time[i];
+            if (t < from_ms || t > to_ms) continue;
+
+            visit(HistorySample{ dev, point, t, s->value[i], s->quality[i] });
+            ++visited;
+        }
+    }
+    return visited;
+}
+
+std::vector<HistorySample> Historian::query(uint16_t dev, uint16_t point,
+                                            uint64_t from_ms, uint64_t to_ms) const
+{
+    std::vector<HistorySample> out;
+    query(dev, point, from_ms, to_ms, [&](const HistorySample& s) { out.push_back(s); });
+    return out;
+}
+
+size_t Historian::scan(uint64_t from_ms, uint64_t to_ms, const HistoryVisitor& visit) const
+{
+    size_t visited = 0;
+    for (const auto& s : snapshot())
+    {
+        uint64_t count = s->hdr->count.load(std::memory_order_acquire);
+        if (count == 0) continue;
+        if (s->hdr->max_time.load(std::memory_order_relaxed) < from_ms ||
+            s->hdr->min_time.load(std::memory_order_relaxed) > to_ms)
+            continue;
+
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            uint64_t t = s->time[i];
+            if (t < from_ms || t > to_ms) continue;
+
+            visit(HistorySample{ s->dev[i], s->point[i], t, s->value[i], s->quality[i] });
+            ++visited;
+        }
+    }
+    return visited;
+}
+
+size_t Historian::segments() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_.size();
+}
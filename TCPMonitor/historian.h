@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* -------------------- HISTORIAN --------------------
+ * Keeps every ingested sample on disk. Samples are appended to
+ * memory-mapped segment files, one column per field so a range scan only
+ * touches the columns it filters on:
+ *
+ *   [4 KiB header][time_ms u64 x N][value f32 x N][dev u16 x N][point u16 x N][quality u8 x N]
+ *
+ * A segment holds a fixed number of records and is sized once with
+ * ftruncate; appending is a handful of stores into the mapping followed by
+ * publishing the new count. When a segment fills, a new one is created and
+ * the oldest is deleted once there are more than max_segments, so disk use
+ * is bounded by max_segments * records_per_segment * 17 bytes.
+ *
+ * Point ids are PointRoute::history_point (point_map.h); the default map
+ * keeps the original ids, TEMP 0 .. RIGHT 4 and KEYPAD 5.
+ *
+ * append() may be called by several ingest workers; they take turns on
+ * write_mutex_, which is uncontended with one worker. query() may run on
+ * any thread at the same time; it sees every record published before it
+ * read the segment's count.
+ */
+
+struct HistorianConfig
+{
+    std::string dir = "history";
+    uint32_t records_per_segment = 1u << 20;   // ~17 MiB per segment
+    size_t max_segments = 16;
+};
+
+struct HistorySample
+{
+    uint16_t dev;
+    uint16_t point;
+    uint64_t time_ms;
+    float value;
+    uint8_t quality;
+};
+
+using HistoryVisitor = std::function<void(const HistorySample&)>;
+
+class Historian
+{
+public:
+    explicit Historian(HistorianConfig config = HistorianConfig{});
+    ~Historian();
+
+    // Creates the directory and reopens existing segments; false on I/O error.
+    bool open();
+
+    bool append(uint16_t dev, uint16_t point, uint64_t time_ms, float value, uint8_t quality);
+
+    // Visits samples of one point with from_ms <= time_ms <= to_ms, oldest
+    // segment first; returns the number visited.
+    size_t query(uint16_t dev, uint16_t point, uint64_t from_ms, uint64_t to_ms,
+                 const HistoryVisitor& visit) const;
+    std::vector<HistorySample> query(uint16_t dev, uint16_t point,
+                                     uint64_t from_ms, uint64_t to_ms) const;
+
+    // Visits every sample with from_ms <= time_ms <= to_ms in one pass,
+    // oldest segment first; returns the number visited. For consumers of
+    // many series at once (the rollup rebuild) instead of a query() each.
+    size_t scan(uint64_t from_ms, uint64_t to_ms, const HistoryVisitor& visit) const;
+
+    size_t segments() const;
+    uint64_t appended() const { return appended_.load(std::memory_order_relaxed); }
+
+private:
+    struct Segment;
+
+    std::vector<std::shared_ptr<Segment>> snapshot() const;
+    std::shared_ptr<Segment> create_segment(uint64_t id);
+    bool rotate();
+
+    HistorianConfig config_;
+    mutable std::mutex mutex_;                        // guards segments_ list only
+    std::vector<std::shared_ptr<Segment>> segments_;  // oldest first
+    std::mutex write_mutex_;                          // serialises append()
+    Segment* active_ = nullptr;                       // under write_mutex_
+    uint64_t next_id_ = 0;
+    std::atomic<uint64_t> appended_{0};
+};
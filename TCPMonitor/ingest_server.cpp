@@ -0,0 +1,426 @@
+#include "ingest_server.h"
+
+#include <scada_wire.h>
+
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+static constexpr int MAX_EVENTS = 256;
+static constexpr size_t READ_CHUNK = 4096;
+static constexpr int READS_PER_EVENT = 16;   // 64 KB, then the next client gets a turn
+static constexpr int UDP_BATCH = 64;
+static constexpr size_t UDP_DATAGRAM_MAX = 2048;
+static constexpr int UDP_RCVBUF = 4 * 1024 * 1024;
+
+IngestServer::IngestServer(uint16_t port, FrameHandler handler)
+    : port_(port), handler_(std::move(handler))
+{
+}
+
+IngestServer::~IngestServer()
+{
+    for (size_t fd = 0; fd < conns_.size(); ++fd)
+    {
+        if (conns_[fd].open) close(static_cast<int>(fd));
+    }
+    if (listen_fd_ >= 0) close(listen_fd_);
+    if (udp_fd_ >= 0)    close(udp_fd_);
+    if (epoll_fd_ >= 0)  close(epoll_fd_);
+    if (wake_fd_ >= 0)   close(wake_fd_);
+    if (notify_fd_ >= 0) close(notify_fd_);
+}
+
+bool IngestServer::open()
+{
+    // thousands of sessions need more than the default 1024 descriptors
+    rlimit lim{};
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max)
+    {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0)
+    {
+        std::cout << "[INGEST] socket() failed: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reuse_port_) setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port_);
+
+    if (bind(listen_fd_, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd_, SOMAXCONN) < 0)
+    {
+        std::cout << "[INGEST] bind/listen on " << port_
+                  << " failed: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    notify_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0 || notify_fd_ < 0) return false;
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+
+    ev.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+    ev.data.fd = notify_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, notify_fd_, &ev);
+
+    return true;
+}
+
+bool IngestServer::open_udp(uint16_t port)
+{
+    udp_fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (udp_fd_ < 0)
+    {
+        std::cout << "[INGEST] UDP socket() failed: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    // absorb bursts while the ingest thread is busy with TCP sessions
+    int rcvbuf = UDP_RCVBUF;
+    setsockopt(udp_fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (reuse_port_)
+    {
+        int opt = 1;
+        setsockopt(udp_fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    if (bind(udp_fd_, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        std::cout << "[INGEST] UDP bind on " << port << " failed: " << strerror(errno) << "\n";
+        close(udp_fd_);
+        udp_fd_ = -1;
+        return false;
+    }
+
+    udp_buf_.resize(UDP_BATCH * UDP_DATAGRAM_MAX);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = udp_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, udp_fd_, &ev);
+    return true;
+}
+
+void IngestServer::stop()
+{
+    uint64_t one = 1;
+    if (wake_fd_ >= 0) (void)!write(wake_fd_, &one, sizeof(one));
+}
+
+void IngestServer::wake()
+{
+    uint64_t one = 1;
+    if (notify_fd_ >= 0) (void)!write(notify_fd_, &one, sizeof(one));
+}
+
+void IngestServer::run()
+{
+    epoll_event events[MAX_EVENTS];
+
+    while (true)
+    {
+        int timeout = timer_ ? timer_() : -1;
+        int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            std::cout << "[INGEST] epoll_wait failed: " << strerror(errno) << "\n";
+            return;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            int fd = events[i].data.fd;
+
+            if (fd == wake_fd_) return;
+
+            if (fd == notify_fd_)
+            {
+                uint64_t count;
+                (void)!read(notify_fd_, &count, sizeof(count));
+                if (wake_handler_) wake_handler_();
+                continue;
+            }
+
+            if (fd == listen_fd_)
+            {
+                accept_all();
+                continue;
+            }
+
+            if (fd == udp_fd_)
+            {
+                read_udp();
+                continue;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                read_client(fd);
+        }
+    }
+}
+
+void IngestServer::accept_all()
+{
+    // bounded so a connect storm cannot starve sessions already in the set
+    for (int i = 0; i < MAX_EVENTS; ++i)
+    {
+        int client = accept4(listen_fd_, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                std::cout << "[INGEST] accept failed: " << strerror(errno) << "\n";
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = client;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client, &ev) < 0)
+        {
+            close(client);
+            continue;
+        }
+
+        // persistent sessions: notice a device that vanished off Wi-Fi
+        int on = 1, idle = 30, intvl = 10, cnt = 3;
+        setsockopt(client, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+        setsockopt(client, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+        setsockopt(client, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+        setsockopt(client, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+
+        if (static_cast<size_t>(client) >= conns_.size())
+            conns_.resize(static_cast<size_t>(client) + 1);
+
+        Conn& c = conns_[client];
+        c.open = true;
+        c.discarding = false;
+        c.binary = false;
+        c.framed = false;
+        c.used = 0;
+        c.accepted = std::chrono::steady_clock::now();
+        open_count_.fetch_add(1, std::memory_order_relaxed);
+
+        // firmware sends right after connect(), so the frame is usually
+        // already queued; skip the extra epoll round trip
+        read_client(client);
+    }
+}
+
+void IngestServer::read_client(int fd)
+{
+    char buf[READ_CHUNK];
+
+    // bounded so one flooding client cannot starve the rest of this worker;
+    // epoll is level-triggered and reports the fd again for what is left
+    for (int reads = 0; reads < READS_PER_EVENT; ++reads)
+    {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n > 0)
+        {
+            feed(fd, buf, static_cast<size_t>(n), std::chrono::steady_clock::now());
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+        // n == 0 (peer closed) or a hard error: an unterminated tail is a
+        // whole frame from a one-shot sender, or a cut one on a framed session
+        Conn& c = conns_[fd];
+        if (c.used > 0 && !c.discarding && !c.binary)
+        {
+            if (c.framed) truncated_.fetch_add(1, std::memory_order_relaxed);
+            else deliver(fd, c.buf, c.used, std::chrono::steady_clock::now());
+        }
+        close_client(fd);
+        return;
+    }
+}
+
+void IngestServer::feed(int fd, const char* data, size_t len,
+                        std::chrono::steady_clock::time_point received)
+{
+    Conn& c = conns_[fd];
+    const char* end = data + len;
+
+    while (data < end)
+    {
+        if (c.binary || (c.used == 0 && !c.discarding &&
+                         static_cast<uint8_t>(*data) == SCADA_WIRE_MAGIC0))
+        {
+            size_t take = std::min<size_t>(SCADA_WIRE_FRAME_SIZE - c.used, end - data);
+            if (c.used == 0 && take == SCADA_WIRE_FRAME_SIZE)
+            {
+                deliver(fd, data, take, received, false);
+            }
+            else
+            {
+                memcpy(c.buf + c.used, data, take);
+                c.used = static_cast<uint16_t>(c.used + take);
+                c.binary = (c.used < SCADA_WIRE_FRAME_SIZE);
+                if (!c.binary)
+                {
+                    deliver(fd, c.buf, c.used, received, false);
+                    c.used = 0;
+                }
+            }
+            data += take;
+            continue;
+        }
+
+        const char* nl = static_cast<const char*>(memchr(data, '\n', end - data));
+        size_t part = (nl ? nl : end) - data;
+
+        if (c.discarding)
+        {
+            if (nl) c.discarding = false;
+        }
+        else if (c.used + part > INGEST_FRAME_MAX)
+        {
+            oversize_.fetch_add(1, std::memory_order_relaxed);
+            c.used = 0;
+            c.discarding = (nl == nullptr);
+        }
+        else if (nl && c.used == 0)
+        {
+            // whole frame inside this read: hand it over without copying
+            deliver(fd, data, part, received);
+        }
+        else
+        {
+            memcpy(c.buf + c.used, data, part);
+            c.used = static_cast<uint16_t>(c.used + part);
+            if (nl)
+            {
+                deliver(fd, c.buf, c.used, received);
+                c.used = 0;
+            }
+        }
+
+        if (!nl) break;
+        c.framed = true;
+        data = nl + 1;
+    }
+}
+
+void IngestServer::deliver(int fd, const char* data, size_t len,
+                           std::chrono::steady_clock::time_point received, bool text)
+{
+    if (text && len > 0 && data[len - 1] == '\r') --len;
+    if (len == 0) return;
+
+    handler_(IngestFrame{ data, len, fd, conns_[fd].accepted, received });
+}
+
+void IngestServer::read_udp()
+{
+    mmsghdr msgs[UDP_BATCH];
+    iovec iov[UDP_BATCH];
+
+    // bounded like accept_all() so a flood cannot starve TCP sessions
+    for (int round = 0; round < 4; ++round)
+    {
+        for (int i = 0; i < UDP_BATCH; ++i)
+        {
+            iov[i].iov_base = udp_buf_.data() + i * UDP_DATAGRAM_MAX;
+            iov[i].iov_len = UDP_DATAGRAM_MAX;
+            msgs[i].msg_hdr = msghdr{};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = recvmmsg(udp_fd_, msgs, UDP_BATCH, MSG_DONTWAIT, nullptr);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR) continue;
+            return;
+        }
+
+        auto received = std::chrono::steady_clock::now();
+        udp_batches_.fetch_add(1, std::memory_order_relaxed);
+        udp_datagrams_.fetch_add(n, std::memory_order_relaxed);
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+            split_datagram(static_cast<const char*>(iov[i].iov_base), msgs[i].msg_len, received);
+        }
+
+        if (n < UDP_BATCH) return;
+    }
+}
+
+// A datagram is self-contained: frames never continue into the next one.
+void IngestServer::split_datagram(const char* data, size_t len,
+                                  std::chrono::steady_clock::time_point received)
+{
+    const char* end = data + len;
+
+    while (data < end)
+    {
+        if (static_cast<uint8_t>(*data) == SCADA_WIRE_MAGIC0)
+        {
+            size_t part = std::min<size_t>(SCADA_WIRE_FRAME_SIZE, end - data);
+            handler_(IngestFrame{ data, part, udp_fd_, received, received });
+            data += part;
+            continue;
+        }
+
+        const char* nl = static_cast<const char*>(memchr(data, '\n', end - data));
+        size_t part = (nl ? nl : end) - data;
+        if (part > 0 && data[part - 1] == '\r') --part;
+        if (part > 0 && part <= INGEST_FRAME_MAX)
+            handler_(IngestFrame{ data, part, udp_fd_, received, received });
+        else if (part > INGEST_FRAME_MAX)
+            oversize_.fetch_add(1, std::memory_order_relaxed);
+
+        if (!nl) break;
+        data = nl + 1;
+    }
+}
+
+void IngestServer::close_client(int fd)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    conns_[fd].open = false;
+    conns_[fd].binary = false;
+    conns_[fd].used = 0;
+    open_count_.fetch_sub(1, std::memory_order_relaxed);
+}
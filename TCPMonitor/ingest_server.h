@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/* -------------------- INGEST SERVER --------------------
+ * Single-threaded, non-blocking TCP ingest built on epoll.
+ * Every connected field device is one fd in the epoll set, so a slow
+ * or silent ESP32 never holds up the others, and each readiness event
+ * reads at most 64 KB so a flooding one cannot either.
+ *
+ * Sessions are long-lived: a device may keep its socket open and send
+ * any number of '\n'-terminated frames. Each session owns a small
+ * reassembly buffer so partial and coalesced frames are split correctly.
+ * When the peer closes, an unterminated tail is delivered only if the
+ * session never sent a '\n', which keeps the older one-frame-per-connection
+ * senders working. On a newline-framed session it is a frame cut by a
+ * broken write: dropped (truncated_frames()), the sender resends it whole.
+ *
+ * A frame whose first byte is SCADA_WIRE_MAGIC0 is a fixed-size binary
+ * frame (scada_wire.h) rather than a text line; it is delivered as soon as
+ * SCADA_WIRE_FRAME_SIZE bytes have arrived, and text and binary frames may
+ * be mixed on one session.
+ *
+ * open_udp() adds a UDP socket to the same epoll set, for telemetry that
+ * can tolerate loss. Datagrams are drained with recvmmsg() in batches of
+ * up to UDP_BATCH per syscall; each may hold one or more text lines or
+ * binary frames. They reach the same FrameHandler on the same thread, so
+ * the handler still has a single writer.
+ *
+ * For multi-core ingest, several servers can share one port: with
+ * set_reuse_port() each binds its own SO_REUSEPORT TCP and UDP socket and
+ * the kernel spreads connections and datagrams across them. Each server
+ * still runs on one thread; wake() lets other threads ask that thread to
+ * run its WakeHandler (e.g. to drain frames handed over to it).
+ */
+
+static constexpr size_t INGEST_FRAME_MAX = 512;
+
+// One complete frame, without the trailing '\n'
+struct IngestFrame
+{
+    const char* data;
+    size_t len;
+    int fd;
+    std::chrono::steady_clock::time_point accepted;
+    std::chrono::steady_clock::time_point received;
+};
+
+using FrameHandler = std::function<void(const IngestFrame&)>;
+
+// Runs on the ingest thread before every epoll_wait; returns how many ms
+// until it wants to run again, or -1 when it has nothing pending.
+using TimerHandler = std::function<int()>;
+
+// Runs on the ingest thread after another thread called wake()
+using WakeHandler = std::function<void()>;
+
+class IngestServer
+{
+public:
+    IngestServer(uint16_t port, FrameHandler handler);
+    ~IngestServer();
+
+    IngestServer(const IngestServer&) = delete;
+    IngestServer& operator=(const IngestServer&) = delete;
+
+    bool open();
+    bool open_udp(uint16_t port);   // after open()
+    void run();
+    void stop();
+
+    void set_timer(TimerHandler timer) { timer_ = std::move(timer); }
+    void set_wake_handler(WakeHandler handler) { wake_handler_ = std::move(handler); }
+    void set_reuse_port(bool on) { reuse_port_ = on; }   // before open()
+
+    // any thread; coalesces until the ingest thread gets to it
+    void wake();
+
+    size_t connections() const { return open_count_.load(std::memory_order_relaxed); }
+    uint64_t oversize_frames() const { return oversize_.load(std::memory_order_relaxed); }
+    uint64_t truncated_frames() const { return truncated_.load(std::memory_order_relaxed); }
+    uint64_t udp_datagrams() const { return udp_datagrams_.load(std::memory_order_relaxed); }
+    uint64_t udp_batches() const { return udp_batches_.load(std::memory_order_relaxed); }
+
+private:
+    struct Conn
+    {
+        bool open = false;
+        bool discarding = false;   // dropping an oversize frame up to its '\n'
+        bool binary = false;       // buf holds the start of a scada_wire frame
+        bool framed = false;       // a '\n' arrived: a tail at close is a cut frame
+        uint16_t used = 0;
+        std::chrono::steady_clock::time_point accepted;
+        char buf[INGEST_FRAME_MAX];
+    };
+
+    void accept_all();
+    void read_client(int fd);
+    void feed(int fd, const char* data, size_t len,
+              std::chrono::steady_clock::time_point received);
+    void deliver(int fd, const char* data, size_t len,
+                 std::chrono::steady_clock::time_point received, bool text = true);
+    void close_client(int fd);
+    void read_udp();
+    void split_datagram(const char* data, size_t len,
+                        std::chrono::steady_clock::time_point received);
+
+    uint16_t port_;
+    FrameHandler handler_;
+    TimerHandler timer_;
+    WakeHandler wake_handler_;
+    bool reuse_port_ = false;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;     // stop()
+    int notify_fd_ = -1;   // wake()
+    std::atomic<size_t> open_count_{0};
+    std::atomic<uint64_t> oversize_{0};
+    std::atomic<uint64_t> truncated_{0};
+
+    int udp_fd_ = -1;
+    std::vector<char> udp_buf_;            // UDP_BATCH datagram buffers
+    std::atomic<uint64_t> udp_datagrams_{0};
+    std::atomic<uint64_t> udp_batches_{0};  // recvmmsg calls that returned data
+    std::vector<Conn> conns_;   // indexed by fd
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/* -------------------- LATENCY HISTOGRAM --------------------
+ * HDR-style log-linear histogram of nanosecond values: every power of two
+ * is split into 16 linear sub-buckets, so any recorded value is reported
+ * within ~6% from 16 ns up to centuries, in a fixed 976-bucket array.
+ *
+ * record() is a couple of relaxed atomic adds, safe from any number of
+ * threads; readers may see a sample half-recorded (count before bucket)
+ * which only matters for exact totals, not percentiles.
+ */
+
+class LatencyHistogram
+{
+public:
+    static constexpr size_t BUCKETS = 976;
+
+    void record(int64_t ns)
+    {
+        uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        counts_[index(v)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t m = max_.load(std::memory_order_relaxed);
+        while (v > m && !max_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // upper edge of the bucket holding the p-th fraction of samples
+    uint64_t percentile(double p) const
+    {
+        uint64_t total = count();
+        if (total == 0) return 0;
+
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * total + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += counts_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(upper(i), max());
+        }
+        return max();
+    }
+
+    void reset()
+    {
+        for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    // "[TRACE] <stage> n=.. p50=..us p90=..us p99=..us p99.9=..us max=..us"
+    void print(const char* tag, const char* stage) const
+    {
+        printf("%s %-20s n=%-8llu p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+               tag, stage, static_cast<unsigned long long>(count()),
+               percentile(0.50) / 1e3, percentile(0.90) / 1e3, percentile(0.99) / 1e3,
+               percentile(0.999) / 1e3, max() / 1e3);
+    }
+
+private:
+    static size_t index(uint64_t v)
+    {
+        if (v < 16) return static_cast<size_t>(v);
+        int shift = 63 - __builtin_clzll(v) - 4;   // keep the top 5 bits
+        return static_cast<size_t>((shift + 1) * 16 + ((v >> shift) - 16));
+    }
+
+    static uint64_t upper(size_t i)
+    {
+        if (i < 16) return i;
+        size_t shift = i / 16 - 1;
+        uint64_t sub = i % 16 + 16;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::atomic<uint64_t> counts_[BUCKETS] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+};
@@ -0,0 +1,403 @@
+/* -------------------- LOAD GENERATOR --------------------
+ * Simulates many ESP32 field devices against a running gateway, so ingest
+ * capacity can be measured without hardware. Each simulated device has
+ * its own DEV id, a type, a report rate and a sequence number, and sends
+ * the same frames as the firmware (ASCII or scada_wire binary).
+ *
+ *   ./loadgen [--host=127.0.0.1] [--port=9100] [--udp-port=9101]
+ *             [--env=N] [--keypad=N] [--sensor=N] [--rotary=N] [--first-dev=0]
+ *             [--env-hz=0.33] [--keypad-hz=0.2] [--sensor-hz=0.5] [--rotary-hz=2]
+ *             [--scale=1] [--mode=persistent|per-sample|udp] [--format=ascii|binary]
+ *             [--threads=4] [--seconds=10] [--seed=1]
+ *
+ * Default rates match the firmware (DHT every 3 s, etc.); --scale
+ * multiplies all of them. Throughput and errors are printed every second
+ * and summed at the end. Exit status is non-zero if any send failed.
+ */
+
+#include <scada_wire.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+using Clock = std::chrono::steady_clock;
+
+enum class Mode { Persistent, PerSample, Udp };
+enum class Format { Ascii, Binary };
+
+struct Options
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 9100;
+    uint16_t udp_port = 9101;
+    int counts[4] = { 4, 1, 1, 1 };                 // ENV, KEYPAD, SENSOR, ROTARY
+    double hz[4] = { 1.0 / 3.0, 0.2, 0.5, 2.0 };
+    double scale = 1.0;
+    int first_dev = 0;
+    Mode mode = Mode::Persistent;
+    Format format = Format::Ascii;
+    int threads = 4;
+    double seconds = 10.0;
+    unsigned seed = 1;
+};
+
+struct Stats
+{
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> connect_errors{0};
+    std::atomic<uint64_t> send_errors{0};
+    std::atomic<uint64_t> reconnects{0};
+    std::atomic<uint64_t> late{0};     // samples sent more than one period behind
+};
+
+static const uint8_t TYPES[4] = { SCADA_WIRE_ENV, SCADA_WIRE_KEYPAD, SCADA_WIRE_SENSOR, SCADA_WIRE_ROTARY };
+static const char* TYPE_NAMES[4] = { "env", "keypad", "sensor", "rotary" };
+
+struct Device
+{
+    int dev;
+    int kind;                          // index into TYPES
+    Clock::duration period;
+    Clock::time_point due;
+    uint32_t seq = 0;
+    int sock = -1;                     // persistent mode
+    float temp = 22.0f, hum = 40.0f;
+    int motion = 0;
+};
+
+/* -------------------- FRAMES -------------------- */
+
+static uint64_t wall_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static size_t make_frame(Device& d, Format format, std::mt19937& rng, char* out, size_t room)
+{
+    static const char KEYS[] = "0123456789*#ABCD";
+    std::uniform_real_distribution<float> step(-0.2f, 0.2f);
+
+    scada_wire_frame w;
+    memset(&w, 0, sizeof(w));
+    w.type = TYPES[d.kind];
+    w.dev = static_cast<uint16_t>(d.dev);
+    w.seq = d.seq++;
+    w.time_ms = wall_ms();
+
+    switch (w.type)
+    {
+    case SCADA_WIRE_ENV:
+        d.temp = std::clamp(d.temp + step(rng), 15.0f, 35.0f);
+        d.hum = std::clamp(d.hum + step(rng), 20.0f, 80.0f);
+        w.u.env.temp = std::round(d.temp * 10.0f) / 10.0f;
+        w.u.env.hum = std::round(d.hum * 10.0f) / 10.0f;
+        break;
+    case SCADA_WIRE_KEYPAD:
+        w.u.keypad.key = KEYS[rng() % (sizeof(KEYS) - 1)];
+        break;
+    case SCADA_WIRE_SENSOR:
+        d.motion ^= 1;
+        w.u.sensor.gpio = 18;
+        w.u.sensor.state = static_cast<uint8_t>(d.motion);
+        break;
+    case SCADA_WIRE_ROTARY:
+        w.u.rotary.left = rng() & 1;
+        w.u.rotary.right = !w.u.rotary.left;
+        break;
+    }
+
+    if (format == Format::Binary)
+        return scada_wire_encode(&w, reinterpret_cast<uint8_t*>(out));
+
+    int n = 0;
+    switch (w.type)
+    {
+    case SCADA_WIRE_ENV:
+        n = snprintf(out, room, "DEV=%d,TYPE=ENV,TEMP=%.1f,HUM=%.1f,SEQ=%u,TS=%llu\n",
+                     d.dev, w.u.env.temp, w.u.env.hum, w.seq,
+                     static_cast<unsigned long long>(w.time_ms));
+        break;
+    case SCADA_WIRE_KEYPAD:
+        n = snprintf(out, room, "DEV=%d,TYPE=KEYPAD,KEY=%c,SEQ=%u,TS=%llu\n",
+                     d.dev, w.u.keypad.key, w.seq, static_cast<unsigned long long>(w.time_ms));
+        break;
+    case SCADA_WIRE_SENSOR:
+        n = snprintf(out, room, "DEV=%d,TYPE=SENSOR,GPIO=%d,STATE=%d,SEQ=%u,TS=%llu\n",
+                     d.dev, w.u.sensor.gpio, w.u.sensor.state, w.seq,
+                     static_cast<unsigned long long>(w.time_ms));
+        break;
+    case SCADA_WIRE_ROTARY:
+        n = snprintf(out, room, "DEV=%d,TYPE=ROTARY,L=%d,R=%d,SEQ=%u,TS=%llu\n",
+                     d.dev, w.u.rotary.left, w.u.rotary.right, w.seq,
+                     static_cast<unsigned long long>(w.time_ms));
+        break;
+    }
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+/* -------------------- SENDING -------------------- */
+
+static int connect_tcp(const sockaddr_in& dest)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+    if (connect(sock, (const sockaddr*)&dest, sizeof(dest)) != 0)
+    {
+        close(sock);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sock;
+}
+
+static bool send_all(int sock, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static void send_sample(Device& d, const Options& opt, const sockaddr_in& tcp, const sockaddr_in& udp,
+                        int udp_sock, const char* msg, size_t len, Stats& st)
+{
+    switch (opt.mode)
+    {
+    case Mode::PerSample:
+    {
+        int sock = connect_tcp(tcp);
+        if (sock < 0)
+        {
+            st.connect_errors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        bool ok = send_all(sock, msg, len);
+        close(sock);
+        if (!ok)
+        {
+            st.send_errors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        break;
+    }
+    case Mode::Persistent:
+    {
+        // like the firmware: reconnect once and retry when the session died
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            if (d.sock < 0)
+            {
+                d.sock = connect_tcp(tcp);
+                if (d.sock < 0)
+                {
+                    st.connect_errors.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                if (d.seq > 1) st.reconnects.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (send_all(d.sock, msg, len)) goto sent;
+            close(d.sock);
+            d.sock = -1;
+        }
+        st.send_errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    case Mode::Udp:
+        if (sendto(udp_sock, msg, len, 0, (const sockaddr*)&udp, sizeof(udp)) != static_cast<ssize_t>(len))
+        {
+            st.send_errors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        break;
+    }
+
+sent:
+    st.sent.fetch_add(1, std::memory_order_relaxed);
+    st.bytes.fetch_add(len, std::memory_order_relaxed);
+}
+
+static void worker(std::vector<Device> devices, const Options& opt, Clock::time_point end,
+                   unsigned seed, Stats& st)
+{
+    sockaddr_in tcp{}, udp{};
+    tcp.sin_family = udp.sin_family = AF_INET;
+    tcp.sin_port = htons(opt.port);
+    udp.sin_port = htons(opt.udp_port);
+    inet_pton(AF_INET, opt.host.c_str(), &tcp.sin_addr);
+    udp.sin_addr = tcp.sin_addr;
+
+    int udp_sock = opt.mode == Mode::Udp ? socket(AF_INET, SOCK_DGRAM, 0) : -1;
+    std::mt19937 rng(seed);
+    char msg[128];
+
+    while (true)
+    {
+        auto now = Clock::now();
+        if (now >= end) break;
+
+        Clock::time_point next = end;
+        for (Device& d : devices)
+        {
+            if (d.due <= now)
+            {
+                size_t len = make_frame(d, opt.format, rng, msg, sizeof(msg));
+                send_sample(d, opt, tcp, udp, udp_sock, msg, len, st);
+
+                d.due += d.period;
+                if (d.due < now)
+                {
+                    // cannot keep up; count it and do not try to catch up in a burst
+                    st.late.fetch_add(1, std::memory_order_relaxed);
+                    d.due = now + d.period;
+                }
+            }
+            next = std::min(next, d.due);
+        }
+
+        auto wait = next - Clock::now();
+        if (wait > Clock::duration::zero()) std::this_thread::sleep_for(wait);
+    }
+
+    for (Device& d : devices)
+        if (d.sock >= 0) close(d.sock);
+    if (udp_sock >= 0) close(udp_sock);
+}
+
+/* -------------------- MAIN -------------------- */
+
+static bool parse_arg(const char* arg, Options& opt)
+{
+    const char* eq = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || !eq) return false;
+    std::string key(arg + 2, eq);
+    const char* v = eq + 1;
+
+    for (int k = 0; k < 4; ++k)
+    {
+        if (key == TYPE_NAMES[k])                        { opt.counts[k] = atoi(v); return true; }
+        if (key == std::string(TYPE_NAMES[k]) + "-hz")   { opt.hz[k] = atof(v); return true; }
+    }
+
+    if (key == "host")      { opt.host = v; return true; }
+    if (key == "port")      { opt.port = static_cast<uint16_t>(atoi(v)); return true; }
+    if (key == "udp-port")  { opt.udp_port = static_cast<uint16_t>(atoi(v)); return true; }
+    if (key == "first-dev") { opt.first_dev = atoi(v); return true; }
+    if (key == "scale")     { opt.scale = atof(v); return true; }
+    if (key == "threads")   { opt.threads = std::max(1, atoi(v)); return true; }
+    if (key == "seconds")   { opt.seconds = atof(v); return true; }
+    if (key == "seed")      { opt.seed = static_cast<unsigned>(strtoul(v, nullptr, 10)); return true; }
+    if (key == "mode")
+    {
+        if (!strcmp(v, "persistent"))      opt.mode = Mode::Persistent;
+        else if (!strcmp(v, "per-sample")) opt.mode = Mode::PerSample;
+        else if (!strcmp(v, "udp"))        opt.mode = Mode::Udp;
+        else return false;
+        return true;
+    }
+    if (key == "format")
+    {
+        if (!strcmp(v, "ascii"))       opt.format = Format::Ascii;
+        else if (!strcmp(v, "binary")) opt.format = Format::Binary;
+        else return false;
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!parse_arg(argv[i], opt))
+        {
+            fprintf(stderr, "unknown option %s (see the header of loadgen.cpp)\n", argv[i]);
+            return 2;
+        }
+    }
+
+    // spread devices round-robin over the worker threads, staggered start
+    std::vector<std::vector<Device>> per_thread(opt.threads);
+    std::mt19937 rng(opt.seed);
+    auto start = Clock::now();
+    int dev = opt.first_dev, total = 0;
+    double target_hz = 0.0;
+
+    for (int k = 0; k < 4; ++k)
+    {
+        double hz = opt.hz[k] * opt.scale;
+        if (hz <= 0.0) continue;
+        auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / hz));
+        std::uniform_int_distribution<int64_t> offset(0, period.count());
+
+        for (int i = 0; i < opt.counts[k]; ++i, ++dev, ++total)
+        {
+            Device d;
+            d.dev = dev;
+            d.kind = k;
+            d.period = period;
+            d.due = start + Clock::duration(offset(rng));
+            per_thread[total % opt.threads].push_back(d);
+            target_hz += hz;
+        }
+    }
+
+    if (dev > 256)
+        printf("[LOADGEN] warning: DEV ids up to %d, the gateway accepts at most 256 devices\n", dev - 1);
+
+    const char* mode = opt.mode == Mode::Udp ? "udp" : opt.mode == Mode::PerSample ? "per-sample" : "persistent";
+    printf("[LOADGEN] %d devices (env=%d keypad=%d sensor=%d rotary=%d) on %d threads, %s %s -> %s, target %.1f frames/s for %.0f s\n",
+           total, opt.counts[0], opt.counts[1], opt.counts[2], opt.counts[3], opt.threads,
+           mode, opt.format == Format::Binary ? "binary" : "ascii", opt.host.c_str(), target_hz, opt.seconds);
+
+    Stats st;
+    auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opt.seconds));
+    std::vector<std::thread> pool;
+    for (int t = 0; t < opt.threads; ++t)
+        pool.emplace_back(worker, std::move(per_thread[t]), std::cref(opt), end, opt.seed + 1 + t, std::ref(st));
+
+    uint64_t last_sent = 0;
+    for (int s = 1; Clock::now() < end; ++s)
+    {
+        std::this_thread::sleep_until(std::min(end, start + std::chrono::seconds(s)));
+        uint64_t sent = st.sent.load();
+        printf("[LOADGEN] t=%ds sent=%llu/s errors=%llu\n", s,
+               static_cast<unsigned long long>(sent - last_sent),
+               static_cast<unsigned long long>(st.connect_errors.load() + st.send_errors.load()));
+        last_sent = sent;
+    }
+    for (auto& t : pool) t.join();
+
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t errors = st.connect_errors.load() + st.send_errors.load();
+    printf("[LOADGEN] sent=%llu (%.1f frames/s of %.1f target, %.1f KB/s) connect_errors=%llu send_errors=%llu reconnects=%llu late=%llu\n",
+           static_cast<unsigned long long>(st.sent.load()), st.sent.load() / secs, target_hz,
+           st.bytes.load() / secs / 1024.0,
+           static_cast<unsigned long long>(st.connect_errors.load()),
+           static_cast<unsigned long long>(st.send_errors.load()),
+           static_cast<unsigned long long>(st.reconnects.load()),
+           static_cast<unsigned long long>(st.late.load()));
+
+    return errors == 0 ? 0 : 1;
+}
@@ -2,17 +2,237 @@
 
 #include <opendnp3/master/MasterStackConfig.h>
 #include <opendnp3/master/DefaultMasterApplication.h>
-#include <opendnp3/master/PrintingSOEHandler.h>
+#include <opendnp3/master/ISOEHandler.h>
+#include <opendnp3/master/CommandSet.h>
 
 #include <opendnp3/channel/PrintingChannelListener.h>
 
+#include "point_cache.h"
+#include "point_map.h"
+#include "latency_histogram.h"
+
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 using namespace opendnp3;
 
-int main()
+/* -------------------- LATENCY --------------------
+ * The gateway stamps every event with the device's own time of the frame
+ * that produced it (TS= or binary time, its own clock for devices without
+ * one). Comparing that with our clock when the event reaches the SOE
+ * handler gives capture-to-master latency for timestamped devices and
+ * ingest-to-master for the rest (all clocks must be NTP-synced).
+ *
+ * Samples go into two histograms: one cleared by every report() and one
+ * kept since start, printed on SIGUSR1 next to the gateway's [TRACE] stages.
+ */
+
+class LatencySOEHandler final : public ISOEHandler
+{
+public:
+    explicit LatencySOEHandler(std::shared_ptr<ISOEHandler> inner) : inner_(std::move(inner)) {}
+
+    void BeginFragment(const ResponseInfo& info) override { inner_->BeginFragment(info); }
+    void EndFragment(const ResponseInfo& info) override { inner_->EndFragment(info); }
+
+    void Process(const HeaderInfo& info, const ICollection<Indexed<Binary>>& values) override
+    {
+        record(info, values);
+        inner_->Process(info, values);
+    }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<Analog>>& values) override
+    {
+        record(info, values);
+        inner_->Process(info, values);
+    }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<Counter>>& values) override
+    {
+        record(info, values);
+        inner_->Process(info, values);
+    }
+
+    void Process(const HeaderInfo& info, const ICollection<Indexed<DoubleBitBinary>>& values) override { inner_->Process(info, values); }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<FrozenCounter>>& values) override { inner_->Process(info, values); }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<BinaryOutputStatus>>& values) override
+    {
+        if (info.isEventVariation)
+        {
+            std::lock_guard<std::mutex> lock(outputs_mutex_);
+            values.ForeachItem([&](const Indexed<BinaryOutputStatus>& v) { outputs_.emplace_back(v.index, v.value.value); });
+        }
+        inner_->Process(info, values);
+    }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<AnalogOutputStatus>>& values) override { inner_->Process(info, values); }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<OctetString>>& values) override { inner_->Process(info, values); }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<TimeAndInterval>>& values) override { inner_->Process(info, values); }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<BinaryCommandEvent>>& values) override { inner_->Process(info, values); }
+    void Process(const HeaderInfo& info, const ICollection<Indexed<AnalogCommandEvent>>& values) override { inner_->Process(info, values); }
+    void Process(const HeaderInfo& info, const ICollection<DNPTime>& values) override { inner_->Process(info, values); }
+
+    // prints count/p50/p99/max since the last call and starts a new window
+    void report()
+    {
+        if (!window_.count()) return;
+
+        std::cout << "[LATENCY] ingest->SOE events=" << window_.count()
+                  << " p50=" << window_.percentile(0.50) / 1000000 << "ms p99=" << window_.percentile(0.99) / 1000000
+                  << "ms max=" << window_.max() / 1000000 << "ms\n";
+        window_.reset();
+    }
+
+    void print_trace() const
+    {
+        std::cout << std::flush;
+        total_.print("[TRACE]", "ingest->SOE");
+        fflush(stdout);
+    }
+
+    // sensor enable switches that changed since the last call (BO events)
+    std::vector<std::pair<uint16_t, bool>> take_outputs()
+    {
+        std::lock_guard<std::mutex> lock(outputs_mutex_);
+        return std::exchange(outputs_, {});
+    }
+
+private:
+    template <class T>
+    void record(const HeaderInfo& info, const ICollection<Indexed<T>>& values)
+    {
+        if (!info.isEventVariation) return;
+
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+        values.ForeachItem([&](const Indexed<T>& v) {
+            if (v.value.time.value == 0) return;
+            int64_t ns = (now - static_cast<int64_t>(v.value.time.value)) * 1000000;
+            window_.record(ns);
+            total_.record(ns);
+        });
+    }
+
+    std::shared_ptr<ISOEHandler> inner_;
+    LatencyHistogram window_;
+    LatencyHistogram total_;
+
+    std::mutex outputs_mutex_;
+    std::vector<std::pair<uint16_t, bool>> outputs_;
+};
+
+/* -------------------- POINT SUMMARY --------------------
+ * The SOE handler only fills the cache; this prints what it holds from the
+ * main loop instead of formatting every value on the DNP3 thread.
+ */
+
+static void print_points(const PointCache& cache)
+{
+    uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    auto line = [&](const char* prefix, const std::pair<uint16_t, PointValue>& p) {
+        std::cout << "[POINTS] " << prefix << p.first << " = " << p.second.value
+                  << " flags=0x" << std::hex << int(p.second.flags) << std::dec
+                  << " updates=" << p.second.updates
+                  << " changed=" << (now - p.second.changed_ms) / 1000 << "s ago\n";
+    };
+
+    for (const auto& p : cache.snapshot(PointKind::Binary))  line("BI", p);
+    for (const auto& p : cache.snapshot(PointKind::Analog))  line("AI", p);
+    for (const auto& p : cache.snapshot(PointKind::Counter)) line("CI", p);
+}
+
+/* -------------------- MAIN --------------------
+ *   ./master          unsolicited class 1/2/3 reporting, integrity every 5 min
+ *   ./master poll     unsolicited off: class 1 every 2 s, class 2/3 every
+ *                     30 s (DHT readings, see pointmap.conf), integrity
+ *                     every 5 min
+ * kill -USR1 prints the ingest->SOE histogram since start. [LINK] lines
+ * give the DNP3 bytes per second actually received.
+ *
+ * Typing "on <k>" or "off <k>" sends a direct operate LATCH_ON/LATCH_OFF
+ * to binary output k, which the gateway turns into that sensor's MQTT
+ * enable switch (control= in pointmap.conf). The operate result prints
+ * when the gateway answers; the device's switch shows up as a BO event.
+ */
+
+static volatile std::sig_atomic_t g_trace_dump = 0;
+
+// same map file as the gateway, so the legend follows its layout
+static void print_legend()
 {
+    PointMap map;
+    std::string error;
+    const char* path = getenv("GATEWAY_POINT_MAP");
+    if (!map.load(path ? path : "pointmap.conf", error))
+        std::cout << "[MAP] " << error << ", using the built-in map\n";
+
+    std::cout << "Each DEV n owns its own index block:\n";
+    for (const std::string& line : map.legend()) std::cout << line << "\n";
+
+    struct Firmware { int dev; const char* name; const char* type; };
+    static const Firmware firmware[] = {
+        { 0, "DHT", "ENV" }, { 1, "Keypad", "KEYPAD" }, { 2, "HCSR501", "SENSOR" }, { 3, "Rotary", "ROTARY" }
+    };
+
+    std::string line;
+    for (const Firmware& fw : firmware)
+    {
+        std::string points;
+        for (const PointRoute& r : map.routes())
+        {
+            if (r.type != fw.type) continue;
+            if (!points.empty()) points += "/";
+            points += point_kind_prefix(r.kind) + std::to_string(map.index(fw.dev, r));
+        }
+        if (points.empty()) continue;
+        line += (line.empty() ? "" : ", ") + std::string("DEV") + std::to_string(fw.dev) + " " + fw.name + " -> " + points;
+    }
+    if (!line.empty()) std::cout << "Default firmware: " << line << "\n";
+}
+
+// operator commands from stdin, one per line: on <k> | off <k>
+static void command_thread(std::shared_ptr<IMaster> master)
+{
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        std::istringstream in(line);
+        std::string verb;
+        unsigned index = 0;
+        if (!(in >> verb >> index) || (verb != "on" && verb != "off") || index > 0xFFFF)
+        {
+            if (!verb.empty()) std::cout << "[CMD] usage: on <k> | off <k>\n";
+            continue;
+        }
+
+        auto op = verb == "on" ? OperationType::LATCH_ON : OperationType::LATCH_OFF;
+        auto sent = std::chrono::steady_clock::now();
+        master->DirectOperate(
+            CommandSet({ WithIndex(ControlRelayOutputBlock(op), static_cast<uint16_t>(index)) }),
+            [verb, index, sent](const ICommandTaskResult& result) {
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sent).count();
+                std::string status = TaskCompletionSpec::to_string(result.summary);
+                result.ForeachItem([&](const CommandPointResult& r) { status = CommandStatusSpec::to_string(r.status); });
+                std::cout << "[CMD] BO" << index << " " << verb << ": " << status << " in " << ms << " ms\n";
+            });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool poll_mode = (argc > 1 && strcmp(argv[1], "poll") == 0);
+    std::signal(SIGUSR1, [](int) { g_trace_dump = 1; });
+
     DNP3Manager manager(1);
 
     auto channel = manager.AddTCPClient(
@@ -25,9 +245,18 @@ int main()
     );
 
     MasterStackConfig config;
-    config.master.disableUnsolOnStartup = true;
+    if (poll_mode)
+    {
+        config.master.disableUnsolOnStartup = true;
+    }
+    else
+    {
+        config.master.disableUnsolOnStartup = false;
+        config.master.unsolClassMask = ClassField::AllEventClasses();
+    }
 
-    auto soe = PrintingSOEHandler::Create();
+    auto cache = std::make_shared<PointCache>();
+    auto soe = std::make_shared<LatencySOEHandler>(std::make_shared<CachingSOEHandler>(cache));
     auto app = std::make_shared<DefaultMasterApplication>();
 
     auto master = channel->AddMaster(
@@ -41,14 +270,44 @@ int main()
 
     master->AddClassScan(
         ClassField::AllClasses(),
-        TimeDuration::Seconds(2),
+        TimeDuration::Minutes(5),
         soe,
         TaskConfig::Default()
     );
 
-    std::cout << "[MASTER] Running\n";
-    std::cout << "BI0 = A Sensor is Online " << "\n" << "AI0 = Temp" << "\n" << "AI1 = Hum" << "\n" << "AI2 = Motion Sensor" << "\n" << "AI3 = Left Active Rotary" << "\n" << "AI4 = Right Active Rotary" << "\n" << "CI0 = Keypad press" << "\n";
+    if (poll_mode)
+    {
+        // the slow class never holds up the fast one
+        master->AddClassScan(ClassField(PointClass::Class1), TimeDuration::Seconds(2), soe, TaskConfig::Default());
+        master->AddClassScan(ClassField(PointClass::Class2), TimeDuration::Seconds(30), soe, TaskConfig::Default());
+        master->AddClassScan(ClassField(PointClass::Class3), TimeDuration::Seconds(30), soe, TaskConfig::Default());
+    }
+
+    std::cout << "[MASTER] Running (" << (poll_mode ? "class 1 poll 2 s, class 2/3 30 s" : "unsolicited") << ")\n";
+    print_legend();
+    std::cout << "[MASTER] Type on <k> / off <k> to switch a sensor (BOk)\n";
+    std::thread(command_thread, master).detach();
+
+    size_t last_rx = 0;
+    for (int tick = 1; ; ++tick)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        for (const auto& o : soe->take_outputs())
+            std::cout << "[CMD] BO" << o.first << " = " << (o.second ? "enabled" : "disabled") << "\n";
+
+        if (tick % 30 == 0)
+        {
+            size_t rx = channel->GetStatistics().channel.numBytesRx;
+            std::cout << "[LINK] rx=" << (rx - last_rx) / 30 << " B/s\n";
+            last_rx = rx;
 
-    while (true)
-        std::this_thread::sleep_for(std::chrono::seconds(5));
+            soe->report();
+            print_points(*cache);
+        }
+        if (g_trace_dump)
+        {
+            g_trace_dump = 0;
+            soe->print_trace();
+        }
+    }
 }
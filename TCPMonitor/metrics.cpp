@@ -0,0 +1,310 @@
+#include "metrics.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* -------------------- HISTOGRAM -------------------- */
+
+MetricHistogram::MetricHistogram(std::vector<double> bounds_s)
+    : bounds_s_(std::move(bounds_s)),
+      counts_(new std::atomic<uint64_t>[bounds_s_.size() + 1])
+{
+    for (double b : bounds_s_) bounds_ns_.push_back(static_cast<uint64_t>(b * 1e9 + 0.5));
+    for (size_t i = 0; i <= bounds_s_.size(); ++i) counts_[i].store(0);
+}
+
+std::vector<double> MetricHistogram::latency_bounds()
+{
+    return { 0.5e-6, 1e-6, 2.5e-6, 5e-6, 10e-6, 25e-6, 50e-6, 100e-6, 250e-6, 500e-6,
+             1e-3, 2.5e-3, 5e-3, 10e-3, 25e-3, 50e-3, 100e-3 };
+}
+
+// shortest text that reads back as the same double: "%.9g" would print a
+// counter past 1e9 as 1.23456789e+09 and Prometheus would see it stall
+// ("%.9g" is for the le bounds only)
+static void append_number(std::string& out, double v)
+{
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr);
+}
+
+static void append_series(std::string& out, const std::string& name, const std::string& labels,
+                          const char* extra_label = nullptr)
+{
+    out += name;
+    if (labels.empty() && !extra_label) return;
+
+    out += '{';
+    out += labels;
+    if (extra_label)
+    {
+        if (!labels.empty()) out += ',';
+        out += extra_label;
+    }
+    out += '}';
+}
+
+void MetricHistogram::render(std::string& out, const std::string& name, const std::string& labels) const
+{
+    // _count comes from the same pass as the buckets, so it always
+    // matches +Inf even while ingest keeps adding
+    uint64_t cumulative = 0;
+    char le[48];
+
+    for (size_t i = 0; i <= bounds_s_.size(); ++i)
+    {
+        cumulative += counts_[i].load(std::memory_order_relaxed);
+        if (i < bounds_s_.size()) snprintf(le, sizeof(le), "le=\"%.9g\"", bounds_s_[i]);
+        else                      snprintf(le, sizeof(le), "le=\"+Inf\"");
+
+        append_series(out, name + "_bucket", labels, le);
+        out += ' ';
+        out += std::to_string(cumulative);
+        out += '\n';
+    }
+
+    append_series(out, name + "_sum", labels);
+    out += ' ';
+    append_number(out, sum_ns_.load(std::memory_order_relaxed) / 1e9);
+    out += '\n';
+
+    append_series(out, name + "_count", labels);
+    out += ' ';
+    out += std::to_string(cumulative);
+    out += '\n';
+}
+
+/* -------------------- REGISTRY -------------------- */
+
+MetricsRegistry::Entry& MetricsRegistry::add(Kind kind, const std::string& name,
+                                             const std::string& help, const std::string& labels)
+{
+    auto e = std::make_unique<Entry>();
+    e->kind = kind;
+    e->name = name;
+    e->help = help;
+    e->labels = labels;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back(std::move(e));
+    return *entries_.back();
+}
+
+MetricCounter& MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                        const std::string& labels)
+{
+    Entry& e = add(Kind::Counter, name, help, labels);
+    e.counter = std::make_unique<MetricCounter>();
+    return *e.counter;
+}
+
+MetricGauge& MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                                    const std::string& labels)
+{
+    Entry& e = add(Kind::Gauge, name, help, labels);
+    e.gauge = std::make_unique<MetricGauge>();
+    return *e.gauge;
+}
+
+MetricHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                            const std::string& labels, std::vector<double> bounds_s)
+{
+    Entry& e = add(Kind::Histogram, name, help, labels);
+    e.histogram = std::make_unique<MetricHistogram>(std::move(bounds_s));
+    return *e.histogram;
+}
+
+void MetricsRegistry::counter_fn(const std::string& name, const std::string& help,
+                                 const std::string& labels, std::function<double()> read)
+{
+    add(Kind::Counter, name, help, labels).read = std::move(read);
+}
+
+void MetricsRegistry::gauge_fn(const std::string& name, const std::string& help,
+                               const std::string& labels, std::function<double()> read)
+{
+    add(Kind::Gauge, name, help, labels).read = std::move(read);
+}
+
+std::string MetricsRegistry::render() const
+{
+    static const char* type_names[] = { "counter", "gauge", "histogram" };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    out.reserve(entries_.size() * 96);
+
+    // the format wants every series of a metric under one HELP/TYPE block
+    std::vector<uint8_t> done(entries_.size(), 0);
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+        if (done[i]) continue;
+        const Entry& first = *entries_[i];
+
+        out += "# HELP " + first.name + " " + first.help + "\n";
+        out += "# TYPE " + first.name + " " + type_names[static_cast<int>(first.kind)] + "\n";
+
+        for (size_t j = i; j < entries_.size(); ++j)
+        {
+            const Entry& e = *entries_[j];
+            if (done[j] || e.name != first.name) continue;
+            done[j] = 1;
+
+            if (e.histogram)
+            {
+                e.histogram->render(out, e.name, e.labels);
+                continue;
+            }
+
+            // counters as integers, no trip through double
+            std::string value;
+            if (!e.read && e.counter)
+            {
+                value = std::to_string(e.counter->value());
+            }
+            else
+            {
+                double v = e.read ? e.read() : e.gauge->value();
+                if (std::isnan(v)) continue;
+                append_number(value, v);
+            }
+
+            append_series(out, e.name, e.labels);
+            out += ' ';
+            out += value;
+            out += '\n';
+        }
+    }
+    return out;
+}
+
+/* -------------------- HTTP SERVER -------------------- */
+
+MetricsServer::MetricsServer(const MetricsRegistry& registry, uint16_t port)
+    : registry_(registry), port_(port)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start()
+{
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0)
+    {
+        std::cout << "[METRICS] socket failed: " << strerror(errno) << "\n";
+        return false;
+    }
+
+    int yes = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port_);
+
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, 8) < 0)
+    {
+        std::cout << "[METRICS] bind/listen on " << port_ << " failed: " << strerror(errno) << "\n";
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    running_.store(true);
+    thread_ = std::thread(&MetricsServer::run, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (!running_.exchange(false)) return;
+
+    shutdown(listen_fd_, SHUT_RDWR);   // wakes the blocking accept()
+    if (thread_.joinable()) thread_.join();
+    close(listen_fd_);
+    listen_fd_ = -1;
+}
+
+void MetricsServer::run()
+{
+    while (running_.load())
+    {
+        int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno == EINTR) continue;
+            if (running_.load()) std::cout << "[METRICS] accept failed: " << strerror(errno) << "\n";
+            return;
+        }
+        serve(client);
+        close(client);
+    }
+}
+
+// one request per connection, then close; enough for Prometheus and curl
+void MetricsServer::serve(int client)
+{
+    timeval timeout{ 2, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char req[2048];
+    size_t used = 0;
+    while (used < sizeof(req) - 1)
+    {
+        ssize_t n = recv(client, req + used, sizeof(req) - 1 - used, 0);
+        if (n <= 0) return;
+        used += static_cast<size_t>(n);
+        req[used] = '\0';
+        if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n")) break;
+    }
+    req[used] = '\0';
+
+    std::string body;
+    const char* status = "200 OK";
+    const char* type = "text/plain; version=0.0.4; charset=utf-8";
+
+    if (strncmp(req, "GET /metrics ", 13) == 0 || strncmp(req, "GET / ", 6) == 0)
+    {
+        body = registry_.render();
+        scrapes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        status = "404 Not Found";
+        type = "text/plain";
+        body = "try GET /metrics\n";
+    }
+
+    std::string resp = "HTTP/1.1 ";
+    resp += status;
+    resp += "\r\nContent-Type: ";
+    resp += type;
+    resp += "\r\nContent-Length: " + std::to_string(body.size());
+    resp += "\r\nConnection: close\r\n\r\n";
+    resp += body;
+
+    size_t sent = 0;
+    while (sent < resp.size())
+    {
+        ssize_t n = send(client, resp.data() + sent, resp.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        sent += static_cast<size_t>(n);
+    }
+}
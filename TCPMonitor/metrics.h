@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* -------------------- METRICS --------------------
+ * Prometheus-style counters, gauges and histograms for the gateway.
+ *
+ * Metrics are registered once at startup and live as long as the
+ * registry; the references handed out stay valid. Updating one is a
+ * relaxed atomic add or store, so the ingest thread never takes a lock
+ * or allocates. Callback metrics are evaluated only while rendering, for
+ * values that already live elsewhere (device table, publisher stats).
+ *
+ * MetricsServer answers "GET /metrics" in the text exposition format
+ * (version 0.0.4) from its own thread; a slow or stuck scraper only
+ * delays the next scrape, never ingest.
+ */
+
+class MetricCounter
+{
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class MetricGauge
+{
+public:
+    void set(double v) { value_.store(v, std::memory_order_relaxed); }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+// Fixed upper bounds in seconds, observed in nanoseconds
+class MetricHistogram
+{
+public:
+    explicit MetricHistogram(std::vector<double> bounds_s);
+
+    void observe_ns(int64_t ns)
+    {
+        uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        size_t i = 0;
+        while (i < bounds_ns_.size() && v > bounds_ns_[i]) ++i;
+        counts_[i].fetch_add(1, std::memory_order_relaxed);
+        sum_ns_.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    void render(std::string& out, const std::string& name, const std::string& labels) const;
+
+    // 0.5 us .. 100 ms, enough for parse time up to a stalled Apply()
+    static std::vector<double> latency_bounds();
+
+private:
+    std::vector<double> bounds_s_;
+    std::vector<uint64_t> bounds_ns_;
+    std::unique_ptr<std::atomic<uint64_t>[]> counts_;   // bounds + the +Inf bucket
+    std::atomic<uint64_t> sum_ns_{0};
+};
+
+class MetricsRegistry
+{
+public:
+    // labels are written as-is inside {}, e.g. reason="bad_header"
+    MetricCounter& counter(const std::string& name, const std::string& help,
+                           const std::string& labels = "");
+    MetricGauge& gauge(const std::string& name, const std::string& help,
+                       const std::string& labels = "");
+    MetricHistogram& histogram(const std::string& name, const std::string& help,
+                               const std::string& labels = "",
+                               std::vector<double> bounds_s = MetricHistogram::latency_bounds());
+
+    // read at scrape time; a NaN result leaves the series out
+    void counter_fn(const std::string& name, const std::string& help,
+                    const std::string& labels, std::function<double()> read);
+    void gauge_fn(const std::string& name, const std::string& help,
+                  const std::string& labels, std::function<double()> read);
+
+    std::string render() const;
+
+private:
+    enum class Kind { Counter, Gauge, Histogram };
+
+    struct Entry
+    {
+        Kind kind;
+        std::string name;
+        std::string help;
+        std::string labels;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+        std::function<double()> read;
+    };
+
+    Entry& add(Kind kind, const std::string& name, const std::string& help, const std::string& labels);
+
+    mutable std::mutex mutex_;   // registration vs render only
+    std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+class MetricsServer
+{
+public:
+    MetricsServer(const MetricsRegistry& registry, uint16_t port);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    bool start();
+    void stop();
+
+    uint64_t scrapes() const { return scrapes_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void serve(int client);
+
+    const MetricsRegistry& registry_;
+    uint16_t port_;
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> scrapes_{0};
+    std::thread thread_;
+};
@@ -0,0 +1,310 @@
+#include "mqtt_bridge.h"
+#include "dnp3_publisher.h"
+
+#include <mosquitto.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+int parse_enable(const char* payload, size_t len)
+{
+    std::string_view p(payload, len);
+    if (p == "ON") return 1;
+    if (p == "OFF") return 0;
+
+    size_t key = p.find("\"enable\"");
+    if (key == std::string_view::npos) return -1;
+    size_t colon = p.find(':', key);
+    if (colon == std::string_view::npos) return -1;
+
+    std::string_view v = p.substr(colon + 1);
+    while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) v.remove_prefix(1);
+    if (v.substr(0, 4) == "true") return 1;
+    if (v.substr(0, 5) == "false") return 0;
+    return -1;
+}
+
+MqttBridge::MqttBridge(const DeviceTable& devices, const PointMap& map, size_t device_count, MqttConfig config)
+    : devices_(devices),
+      map_(map),
+      device_count_(device_count),
+      config_(std::move(config)),
+      sent_(device_count),
+      evented_(map.types()),
+      requested_(new std::atomic<int8_t>[map.types()]),
+      reported_(new std::atomic<int8_t>[map.types()]),
+      pending_(map.types())
+{
+    for (size_t t = 0; t < map.types(); ++t)
+    {
+        requested_[t].store(-1);
+        reported_[t].store(-1);
+    }
+    for (const PointRoute& r : map.routes())
+        if (r.every || r.soe) evented_[r.type_id] = true;
+}
+
+MqttBridge::~MqttBridge()
+{
+    stop();
+}
+
+bool MqttBridge::start()
+{
+    mosquitto_lib_init();
+    mosq_ = mosquitto_new(config_.client_id.c_str(), true, this);
+    if (!mosq_)
+    {
+        std::cout << "[MQTT] mosquitto_new failed\n";
+        return false;
+    }
+
+    mosquitto_connect_callback_set(mosq_, &MqttBridge::on_connect);
+    mosquitto_disconnect_callback_set(mosq_, &MqttBridge::on_disconnect);
+    mosquitto_publish_callback_set(mosq_, &MqttBridge::on_publish);
+    mosquitto_message_callback_set(mosq_, &MqttBridge::on_message);
+    mosquitto_reconnect_delay_set(mosq_, 1, 30, true);
+    mosquitto_max_inflight_messages_set(mosq_, 0);   // QoS 1 state is never held back behind acks
+
+    // async: a broker that is down now is retried by the loop thread
+    int rc = mosquitto_connect_async(mosq_, config_.host.c_str(), config_.port, 30);
+    if (rc != MOSQ_ERR_SUCCESS)
+        std::cout << "[MQTT] connect to " << config_.host << ":" << config_.port << ": " << mosquitto_strerror(rc) << ", retrying\n";
+
+    rc = mosquitto_loop_start(mosq_);
+    if (rc != MOSQ_ERR_SUCCESS)
+    {
+        std::cout << "[MQTT] loop_start: " << mosquitto_strerror(rc) << "\n";
+        mosquitto_destroy(mosq_);
+        mosq_ = nullptr;
+        return false;
+    }
+
+    running_.store(true);
+    thread_ = std::thread(&MqttBridge::run, this);
+    return true;
+}
+
+void MqttBridge::stop()
+{
+    if (!running_.exchange(false)) return;
+
+    if (thread_.joinable()) thread_.join();
+    mosquitto_disconnect(mosq_);
+    mosquitto_loop_stop(mosq_, false);
+    mosquitto_destroy(mosq_);
+    mosq_ = nullptr;
+    mosquitto_lib_cleanup();
+}
+
+int MqttBridge::enabled(size_t type_id) const
+{
+    if (type_id >= map_.types()) return -1;
+    int reported = reported_[type_id].load(std::memory_order_relaxed);
+    return reported >= 0 ? reported : requested_[type_id].load(std::memory_order_relaxed);
+}
+
+/* -------------------- CALLBACKS (libmosquitto thread) -------------------- */
+
+void MqttBridge::on_connect(mosquitto* m, void* self, int rc)
+{
+    auto* b = static_cast<MqttBridge*>(self);
+    if (rc != 0)
+    {
+        std::cout << "[MQTT] broker refused: " << mosquitto_connack_string(rc) << "\n";
+        return;
+    }
+
+    b->stats_.connects.fetch_add(1, std::memory_order_relaxed);
+    b->connected_.store(true);
+    b->resync_.store(true);
+    mosquitto_subscribe(m, nullptr, "sensors/+/0/cmd", 1);
+    mosquitto_subscribe(m, nullptr, "sensors/+/0/status", 1);
+    std::cout << "[MQTT] Connected to " << b->config_.host << ":" << b->config_.port << "\n";
+}
+
+void MqttBridge::on_disconnect(mosquitto*, void* self, int rc)
+{
+    auto* b = static_cast<MqttBridge*>(self);
+    b->connected_.store(false);
+    if (rc != 0 && b->running_.load()) std::cout << "[MQTT] Lost the broker, reconnecting\n";
+}
+
+void MqttBridge::on_publish(mosquitto*, void* self, int mid)
+{
+    auto* b = static_cast<MqttBridge*>(self);
+    if (b->in_flight_.load() == 0)
+    {
+        b->stats_.delivered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(b->commands_mutex_);
+    for (PendingCommand& c : b->pending_)
+    {
+        if (c.enable < 0 || c.broker_acked || c.mid != mid) continue;
+        c.broker_acked = true;
+        b->in_flight_.fetch_sub(1);
+        b->trace_.to_broker.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - c.sent).count());
+        return;
+    }
+    b->stats_.delivered.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MqttBridge::on_message(mosquitto*, void* self, const mosquitto_message* msg)
+{
+    static_cast<MqttBridge*>(self)->handle(msg->topic, static_cast<const char*>(msg->payload),
+                                           static_cast<size_t>(msg->payloadlen));
+}
+
+// sensors/<name>/0/cmd or sensors/<name>/0/status
+void MqttBridge::handle(const std::string& topic, const char* payload, size_t len)
+{
+    stats_.received.fetch_add(1, std::memory_order_relaxed);
+
+    std::string_view t(topic);
+    if (t.substr(0, 8) != "sensors/") return;
+    t.remove_prefix(8);
+
+    size_t slash = t.find('/');
+    if (slash == std::string_view::npos) return;
+    int type = map_.find_mqtt(t.substr(0, slash));
+    std::string_view rest = t.substr(slash);
+    int value = parse_enable(payload, len);
+    if (type < 0 || value < 0) return;
+
+    if (rest == "/0/cmd")
+    {
+        requested_[type].store(static_cast<int8_t>(value));
+        return;
+    }
+    if (rest != "/0/status") return;
+    reported_[type].store(static_cast<int8_t>(value));
+
+    int64_t ack_ns = -1;
+    {
+        std::lock_guard<std::mutex> lock(commands_mutex_);
+        PendingCommand& c = pending_[type];
+        if (c.enable == value)
+        {
+            ack_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - c.sent).count();
+            if (!c.broker_acked) in_flight_.fetch_sub(1);
+            c = PendingCommand{};
+        }
+    }
+
+    if (ack_ns >= 0)
+    {
+        stats_.command_acks.fetch_add(1, std::memory_order_relaxed);
+        trace_.to_ack.record(ack_ns);
+        if (ack_metric_) ack_metric_->observe_ns(ack_ns);
+    }
+    if (status_listener_) status_listener_(static_cast<size_t>(type), value == 1, ack_ns);
+}
+
+/* -------------------- COMMANDS (any thread) -------------------- */
+
+bool MqttBridge::send_command(size_t type_id, bool enable)
+{
+    if (type_id >= map_.types() || !connected()) return false;
+
+    std::string topic = "sensors/" + map_.mqtt_name(type_id) + "/0/cmd";
+    const char* payload = enable ? "{\"enable\": true}" : "{\"enable\": false}";
+
+    // held across the publish so the PUBACK cannot be matched before the mid is stored
+    std::lock_guard<std::mutex> lock(commands_mutex_);
+    PendingCommand& c = pending_[type_id];
+    if (c.enable >= 0 && !c.broker_acked) in_flight_.fetch_sub(1);   // superseded
+
+    // counted first so on_publish() looks for it even if the PUBACK beats us here
+    in_flight_.fetch_add(1);
+    int mid = 0;
+    auto sent = std::chrono::steady_clock::now();
+    int rc = mosquitto_publish(mosq_, &mid, topic.c_str(), static_cast<int>(strlen(payload)), payload, 1, true);
+    if (rc != MOSQ_ERR_SUCCESS)
+    {
+        in_flight_.fetch_sub(1);
+        c = PendingCommand{};
+        return false;
+    }
+
+    c.enable = enable ? 1 : 0;
+    c.mid = mid;
+    c.broker_acked = false;
+    c.sent = sent;
+    requested_[type_id].store(c.enable);
+    stats_.commands.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+/* -------------------- STATE PUBLISHING (bridge thread) -------------------- */
+
+void MqttBridge::run()
+{
+    while (running_.load())
+    {
+        std::this_thread::sleep_for(config_.batch);
+        if (connected_.load()) publish_changed();
+    }
+}
+
+void MqttBridge::publish_changed()
+{
+    if (resync_.exchange(false))
+        for (Sent& s : sent_) s.valid = false;
+
+    auto steady_now = std::chrono::steady_clock::now();
+    uint64_t now_ms = wall_clock_ms();
+    bool any = false;
+
+    for (size_t dev = 0; dev < device_count_; ++dev)
+    {
+        DeviceState d = devices_.load(dev);
+        if (!d.seen || d.type >= map_.types()) continue;
+
+        Sent& s = sent_[dev];
+        if (s.valid && s.type == d.type && s.events == d.events &&
+            std::memcmp(s.values, d.values, sizeof(d.values)) == 0) continue;
+
+        char payload[512];
+        size_t used = 0;
+        auto append = [&](int n) { used = std::min(used + std::max(n, 0), sizeof(payload) - 1); };
+
+        // when the gateway committed it, in wall-clock ms
+        auto age = std::chrono::duration_cast<std::chrono::milliseconds>(steady_now - d.last_update).count();
+        append(snprintf(payload, sizeof(payload), "{\"dev\":%zu,\"type\":\"%s\"", dev, map_.type_name(d.type).c_str()));
+        for (size_t r = 0; r < map_.routes().size() && r < DEVICE_VALUES; ++r)
+        {
+            const PointRoute& route = map_.route(r);
+            if (route.type_id != d.type) continue;
+            append(snprintf(payload + used, sizeof(payload) - used, ",\"%s\":%g", route.field.c_str(), d.values[r]));
+        }
+        if (evented_[d.type])
+            append(snprintf(payload + used, sizeof(payload) - used, ",\"events\":%u", d.events));
+        append(snprintf(payload + used, sizeof(payload) - used, ",\"time\":%llu}",
+                        static_cast<unsigned long long>(now_ms - std::max<int64_t>(age, 0))));
+
+        std::string topic = "sensors/" + map_.mqtt_name(d.type) + "/" + std::to_string(dev) + "/state";
+        int rc = mosquitto_publish(mosq_, nullptr, topic.c_str(), static_cast<int>(used), payload,
+                                   config_.qos, config_.retain);
+        if (rc != MOSQ_ERR_SUCCESS)
+        {
+            // not marked as sent: the next round tries again
+            stats_.failed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        s.valid = true;
+        s.type = d.type;
+        s.events = d.events;
+        std::memcpy(s.values, d.values, sizeof(d.values));
+        stats_.published.fetch_add(1, std::memory_order_relaxed);
+        any = true;
+    }
+
+    if (any) stats_.batches.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "device_table.h"
+#include "point_map.h"
+#include "latency_histogram.h"
+#include "metrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct mosquitto;
+struct mosquitto_message;
+
+/* -------------------- MQTT BRIDGE --------------------
+ * Publishes device state to the broker the firmware and masterLCD.py
+ * already use (mosquitto per ExMosquitto.conf, port 1885), so MQTT
+ * consumers get readings without polling DNP3:
+ *
+ *   sensors/<name>/<dev>/state   {"dev":0,"type":"ENV","TEMP":21.5,"HUM":40.1,"time":<ms>}
+ *
+ * <name> is the TYPE's mqtt name from the point map (dht, keypad, ...).
+ * The bridge thread reads the device table every `batch` and publishes
+ * one retained message per device whose values changed since the last
+ * one, so ingest never waits on the broker and bursts collapse to the
+ * latest state (every edge still reaches DNP3 through the SOE rings).
+ * A TYPE with event=every or event=soe points also carries "events", the
+ * device's count of those events: a key pressed twice or a motion on/off
+ * pair between two rounds leaves the values as they were, but the count
+ * moves, so the message goes out and consumers see how many they missed.
+ * libmosquitto's own thread writes the queued messages back to back;
+ * with QoS 1 it keeps them in flight while it waits for the PUBACKs.
+ *
+ * It also subscribes to the enable switches: sensors/+/0/cmd (retained
+ * {"enable": bool} from masterLCD.py) and sensors/+/0/status (what the
+ * firmware reports it applied). enabled() returns the reported state,
+ * falling back to the requested one.
+ *
+ * send_command() is the other direction, for DNP3 controls: it queues
+ * {"enable": bool} on sensors/<name>/0/cmd (retained, QoS 1, like
+ * masterLCD.py) and returns at once, so commands to several sensors are
+ * in flight together. Each is timed to the broker's PUBACK and to the
+ * firmware's matching .../status report (the ack).
+ *
+ * Losing the broker never stops the gateway: libmosquitto reconnects in
+ * the background and the next batch republishes whatever changed.
+ */
+
+struct MqttConfig
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 1885;       // 0 = off
+    int qos = 0;
+    bool retain = true;
+    std::chrono::milliseconds batch{250};
+    std::string client_id = "scada-gateway";
+};
+
+struct MqttStats
+{
+    std::atomic<uint64_t> published{0};     // state messages handed to libmosquitto
+    std::atomic<uint64_t> delivered{0};     // written (QoS 0) or acknowledged (QoS 1)
+    std::atomic<uint64_t> failed{0};        // mosquitto_publish() refused, e.g. not connected
+    std::atomic<uint64_t> batches{0};       // bridge rounds that published something
+    std::atomic<uint64_t> received{0};      // cmd/status messages
+    std::atomic<uint64_t> connects{0};
+    std::atomic<uint64_t> commands{0};      // enable commands queued
+    std::atomic<uint64_t> command_acks{0};  // ... and confirmed by the device's status
+};
+
+struct CommandTrace
+{
+    LatencyHistogram to_broker;     // send_command() -> PUBACK
+    LatencyHistogram to_ack;        // send_command() -> matching .../status
+};
+
+class MqttBridge
+{
+public:
+    // `devices` and `map` must outlive the bridge
+    MqttBridge(const DeviceTable& devices, const PointMap& map, size_t device_count, MqttConfig config);
+    ~MqttBridge();
+
+    MqttBridge(const MqttBridge&) = delete;
+    MqttBridge& operator=(const MqttBridge&) = delete;
+
+    bool start();
+    void stop();
+
+    bool connected() const { return connected_.load(std::memory_order_relaxed); }
+
+    // per TYPE id: 1 enabled, 0 disabled, -1 never heard
+    int enabled(size_t type_id) const;
+
+    // false when the broker is not connected or the client refused it
+    bool send_command(size_t type_id, bool enable);
+
+    // Runs on the libmosquitto thread for every .../status report;
+    // ack_ns is the command-to-ack time when it confirms a command, else -1.
+    using StatusListener = std::function<void(size_t type_id, bool enabled, int64_t ack_ns)>;
+    void set_status_listener(StatusListener fn) { status_listener_ = std::move(fn); }   // before start()
+    void set_ack_metric(MetricHistogram* h) { ack_metric_ = h; }
+
+    const CommandTrace& command_trace() const { return trace_; }
+
+    const MqttStats& stats() const { return stats_; }
+    const MqttConfig& config() const { return config_; }
+
+private:
+    static void on_connect(mosquitto* m, void* self, int rc);
+    static void on_disconnect(mosquitto* m, void* self, int rc);
+    static void on_publish(mosquitto* m, void* self, int mid);
+    static void on_message(mosquitto* m, void* self, const mosquitto_message* msg);
+
+    void run();
+    void publish_changed();
+    void handle(const std::string& topic, const char* payload, size_t len);
+
+    const DeviceTable& devices_;
+    const PointMap& map_;
+    size_t device_count_;
+    MqttConfig config_;
+    MqttStats stats_;
+
+    mosquitto* mosq_ = nullptr;
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    // bridge thread only: what each device last published
+    struct Sent
+    {
+        bool valid = false;
+        uint8_t type = 0;
+        uint32_t events = 0;
+        float values[DEVICE_VALUES] = {};
+    };
+    std::vector<Sent> sent_;
+    std::vector<bool> evented_;         // per TYPE: has event=every/soe points, publishes "events"
+
+    std::atomic<bool> resync_{false};     // (re)connected: publish every device again
+    std::unique_ptr<std::atomic<int8_t>[]> requested_;   // per TYPE, from .../cmd
+    std::unique_ptr<std::atomic<int8_t>[]> reported_;    // per TYPE, from .../status
+
+    // last command per TYPE until its status comes back
+    struct PendingCommand
+    {
+        int8_t enable = -1;         // -1 = none
+        int mid = 0;
+        bool broker_acked = false;
+        std::chrono::steady_clock::time_point sent;
+    };
+    std::mutex commands_mutex_;
+    std::vector<PendingCommand> pending_;
+    std::atomic<int> in_flight_{0};     // pending_ entries waiting for a PUBACK
+
+    StatusListener status_listener_;
+    MetricHistogram* ack_metric_ = nullptr;
+    CommandTrace trace_;
+};
+
+// {"enable": true} or ON/OFF, as the firmware accepts; -1 when neither
+int parse_enable(const char* payload, size_t len);
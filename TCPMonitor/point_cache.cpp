@@ -0,0 +1,85 @@
+#include "point_cache.h"
+
+#include <chrono>
+
+using namespace opendnp3;
+
+static uint64_t now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/* -------------------- POINT CACHE -------------------- */
+
+void PointCache::update(PointKind kind, uint16_t index, double value, uint8_t flags,
+                        uint64_t time_ms, uint64_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Table& t = tables_[static_cast<size_t>(kind)];
+
+    if (index >= t.values.size())
+    {
+        t.values.resize(static_cast<size_t>(index) + 1);
+        t.valid.resize(static_cast<size_t>(index) + 1, 0);
+    }
+
+    PointValue& p = t.values[index];
+    if (!t.valid[index] || p.value != value) p.changed_ms = now;
+
+    p.value = value;
+    p.flags = flags;
+    p.time_ms = time_ms;
+    p.received_ms = now;
+    ++p.updates;
+    t.valid[index] = 1;
+}
+
+std::optional<PointValue> PointCache::get(PointKind kind, uint16_t index) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Table& t = tables_[static_cast<size_t>(kind)];
+
+    if (index >= t.values.size() || !t.valid[index]) return std::nullopt;
+    return t.values[index];
+}
+
+std::vector<std::pair<uint16_t, PointValue>> PointCache::snapshot(PointKind kind) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Table& t = tables_[static_cast<size_t>(kind)];
+
+    std::vector<std::pair<uint16_t, PointValue>> out;
+    for (size_t i = 0; i < t.values.size(); ++i)
+    {
+        if (t.valid[i]) out.emplace_back(static_cast<uint16_t>(i), t.values[i]);
+    }
+    return out;
+}
+
+/* -------------------- SOE HANDLER -------------------- */
+
+template <class T>
+static void store(PointCache& cache, PointKind kind, const ICollection<Indexed<T>>& values)
+{
+    uint64_t now = now_ms();
+    values.ForeachItem([&](const Indexed<T>& v) {
+        cache.update(kind, v.index, static_cast<double>(v.value.value),
+                     v.value.flags.value, v.value.time.value, now);
+    });
+}
+
+void CachingSOEHandler::Process(const HeaderInfo&, const ICollection<Indexed<Binary>>& values)
+{
+    store(*cache_, PointKind::Binary, values);
+}
+
+void CachingSOEHandler::Process(const HeaderInfo&, const ICollection<Indexed<Analog>>& values)
+{
+    store(*cache_, PointKind::Analog, values);
+}
+
+void CachingSOEHandler::Process(const HeaderInfo&, const ICollection<Indexed<Counter>>& values)
+{
+    store(*cache_, PointKind::Counter, values);
+}
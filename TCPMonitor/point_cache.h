@@ -0,0 +1,77 @@
+#pragma once
+
+#include <opendnp3/master/ISOEHandler.h>
+
+#include "point_map.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/* -------------------- POINT CACHE --------------------
+ * Current value of every point the master has seen, addressed by DNP3
+ * type and index. CachingSOEHandler fills it from the DNP3 thread without
+ * formatting anything; other code reads it through get()/snapshot().
+ */
+
+struct PointValue
+{
+    double value = 0.0;
+    uint8_t flags = 0;          // DNP3 quality flags (0x01 = ONLINE)
+    uint64_t time_ms = 0;       // outstation timestamp, 0 when not reported
+    uint64_t received_ms = 0;   // local wall clock of the last report
+    uint64_t changed_ms = 0;    // local wall clock when the value last changed
+    uint32_t updates = 0;
+};
+
+class PointCache
+{
+public:
+    void update(PointKind kind, uint16_t index, double value, uint8_t flags,
+                uint64_t time_ms, uint64_t now_ms);
+
+    std::optional<PointValue> get(PointKind kind, uint16_t index) const;
+
+    // every point of one kind that has been reported, in index order
+    std::vector<std::pair<uint16_t, PointValue>> snapshot(PointKind kind) const;
+
+private:
+    struct Table
+    {
+        std::vector<PointValue> values;
+        std::vector<uint8_t> valid;
+    };
+
+    mutable std::mutex mutex_;
+    Table tables_[POINT_KINDS];
+};
+
+class CachingSOEHandler final : public opendnp3::ISOEHandler
+{
+public:
+    explicit CachingSOEHandler(std::shared_ptr<PointCache> cache) : cache_(std::move(cache)) {}
+
+    void BeginFragment(const opendnp3::ResponseInfo&) override {}
+    void EndFragment(const opendnp3::ResponseInfo&) override {}
+
+    void Process(const opendnp3::HeaderInfo& info, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::Binary>>& values) override;
+    void Process(const opendnp3::HeaderInfo& info, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::Analog>>& values) override;
+    void Process(const opendnp3::HeaderInfo& info, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::Counter>>& values) override;
+
+    // not produced by the gateway
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::DoubleBitBinary>>&) override {}
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::FrozenCounter>>&) override {}
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::BinaryOutputStatus>>&) override {}
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::AnalogOutputStatus>>&) override {}
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::OctetString>>&) override {}
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::TimeAndInterval>>&) override {}
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::BinaryCommandEvent>>&) override {}
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::Indexed<opendnp3::AnalogCommandEvent>>&) override {}
+    void Process(const opendnp3::HeaderInfo&, const opendnp3::ICollection<opendnp3::DNPTime>&) override {}
+
+private:
+    std::shared_ptr<PointCache> cache_;
+};
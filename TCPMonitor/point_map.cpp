@@ -0,0 +1,466 @@
+#include "point_map.h"
+#include "frame_parser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+
+static_assert(FRAME_FIELDS_MAX <= MAPPED_FIELDS_MAX, "a frame must fit one MappedFrame");
+
+template <class T>
+static bool to_num(std::string_view v, T& out)
+{
+    const char* end = v.data() + v.size();
+    auto r = std::from_chars(v.data(), end, out);
+    return r.ec == std::errc() && r.ptr == end;
+}
+
+// keep in step with pointmap.conf
+static const char DEFAULT_MAP[] = R"(
+block analog  5
+block binary  1
+block counter 1
+online 0
+
+events binary  4
+events analog  16
+events counter 16
+
+point ENV    TEMP  analog  0 class=2 deadband=0.25 svar=g30v5 evar=g32v7 rollup label=Temp
+point ENV    HUM   analog  1 class=2 deadband=1    svar=g30v5 evar=g32v7 rollup label=Hum
+point SENSOR STATE analog  2 class=1 event=soe svar=g30v2 evar=g32v4 label=Motion Sensor
+point ROTARY L     analog  3 class=1 event=soe svar=g30v1 evar=g32v3 label=Left Active Rotary
+point ROTARY R     analog  4 class=1 event=soe svar=g30v1 evar=g32v3 label=Right Active Rotary
+point KEYPAD KEY   counter 0 class=1 event=every svar=g20v2 evar=g22v6 label=Keypad press
+
+mqtt ENV    dht     control=0
+mqtt KEYPAD keypad  control=1
+mqtt SENSOR mosense control=2
+mqtt ROTARY rotary  control=3
+)";
+
+const char* point_kind_name(PointKind kind)
+{
+    switch (kind)
+    {
+    case PointKind::Binary:  return "binary";
+    case PointKind::Analog:  return "analog";
+    default:                 return "counter";
+    }
+}
+
+const char* point_kind_prefix(PointKind kind)
+{
+    switch (kind)
+    {
+    case PointKind::Binary:  return "BI";
+    case PointKind::Analog:  return "AI";
+    default:                 return "CI";
+    }
+}
+
+uint8_t static_group(PointKind kind)
+{
+    switch (kind)
+    {
+    case PointKind::Binary:  return 1;
+    case PointKind::Analog:  return 30;
+    default:                 return 20;
+    }
+}
+
+uint8_t event_group(PointKind kind)
+{
+    switch (kind)
+    {
+    case PointKind::Binary:  return 2;
+    case PointKind::Analog:  return 32;
+    default:                 return 22;
+    }
+}
+
+// variations opendnp3 can report for each group
+static bool known_variation(uint8_t group, uint8_t var)
+{
+    switch (group)
+    {
+    case 1:  return var == 1 || var == 2;
+    case 2:  return var >= 1 && var <= 3;
+    case 30: return var >= 1 && var <= 6;
+    case 32: return var >= 1 && var <= 8;
+    case 20:
+    case 22: return var == 1 || var == 2 || var == 5 || var == 6;
+    default: return false;
+    }
+}
+
+// "g30v5" -> 5 when the group is `group`
+static bool parse_variation(std::string_view s, uint8_t group, uint8_t& var)
+{
+    size_t v = s.find('v');
+    unsigned g = 0;
+    if (s.size() < 4 || s[0] != 'g' || v == std::string_view::npos) return false;
+    if (!to_num(s.substr(1, v - 1), g) || g != group) return false;
+    return to_num(s.substr(v + 1), var) && known_variation(group, var);
+}
+
+static bool parse_kind(std::string_view s, PointKind& kind)
+{
+    for (PointKind k : { PointKind::Binary, PointKind::Analog, PointKind::Counter })
+    {
+        if (s == point_kind_name(k))
+        {
+            kind = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '\r')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+// next whitespace-separated word of `s`, consumed
+static std::string_view next_word(std::string_view& s)
+{
+    s = trim(s);
+    size_t end = s.find_first_of(" \t");
+    std::string_view w = s.substr(0, end);
+    s.remove_prefix(end == std::string_view::npos ? s.size() : end);
+    return w;
+}
+
+PointMap::PointMap()
+{
+    std::string error;
+    parse(DEFAULT_MAP, "built-in map", error);
+}
+
+bool PointMap::load(const std::string& path, std::string& error)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        error = path + ": cannot open";
+        return false;
+    }
+
+    std::ostringstream text;
+    text << in.rdbuf();
+    return parse(text.str(), path, error);
+}
+
+bool PointMap::parse(std::string_view text, const std::string& source, std::string& error)
+{
+    uint16_t stride[POINT_KINDS] = { 1, 1, 1 };
+    uint16_t events[POINT_KINDS] = {};
+    int online = -1;
+    std::vector<PointRoute> routes;
+    std::vector<int> route_line;
+    struct MqttLine
+    {
+        std::string type;
+        std::string name;
+        int control = -1;
+        int line = 0;
+    };
+    std::vector<MqttLine> mqtt;
+    int line_no = 0;
+
+    auto fail = [&](int line, const std::string& msg) {
+        error = source + ":" + std::to_string(line) + ": " + msg;
+        return false;
+    };
+
+    while (!text.empty())
+    {
+        size_t nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+        ++line_no;
+
+        size_t hash = line.find('#');
+        if (hash != std::string_view::npos) line = line.substr(0, hash);
+        line = trim(line);
+        if (line.empty()) continue;
+
+        std::string_view word = next_word(line);
+
+        if (word == "block")
+        {
+            PointKind kind;
+            uint16_t n = 0;
+            if (!parse_kind(next_word(line), kind) || !to_num(next_word(line), n) || n == 0 || !trim(line).empty())
+                return fail(line_no, "expected: block <analog|binary|counter> <points per device>");
+            stride[static_cast<size_t>(kind)] = n;
+        }
+        else if (word == "events")
+        {
+            PointKind kind;
+            uint16_t n = 0;
+            if (!parse_kind(next_word(line), kind) || !to_num(next_word(line), n) || n == 0 || !trim(line).empty())
+                return fail(line_no, "expected: events <analog|binary|counter> <events per device>");
+            events[static_cast<size_t>(kind)] = n;
+        }
+        else if (word == "online")
+        {
+            uint16_t offset = 0;
+            if (!to_num(next_word(line), offset) || !trim(line).empty())
+                return fail(line_no, "expected: online <binary offset>");
+            online = offset;
+        }
+        else if (word == "mqtt")
+        {
+            MqttLine m;
+            m.type = std::string(next_word(line));
+            m.name = std::string(next_word(line));
+            std::string_view opt = next_word(line);
+            bool ok = !m.name.empty() && m.name.find_first_of("/+#") == std::string::npos && trim(line).empty();
+            if (ok && !opt.empty())
+                ok = opt.substr(0, 8) == "control=" && to_num(opt.substr(8), m.control) && m.control >= 0;
+            if (!ok) return fail(line_no, "expected: mqtt <TYPE> <topic name> [control=<binary output>]");
+            m.line = line_no;
+            mqtt.push_back(std::move(m));
+        }
+        else if (word == "point")
+        {
+            PointRoute r;
+            r.type = std::string(next_word(line));
+            r.field = std::string(next_word(line));
+            if (r.field.empty() || !parse_kind(next_word(line), r.kind) || !to_num(next_word(line), r.offset))
+                return fail(line_no, "expected: point <TYPE> <FIELD> <analog|binary|counter> <offset> [options]");
+
+            for (std::string_view opt = next_word(line); !opt.empty(); opt = next_word(line))
+            {
+                size_t eq = opt.find('=');
+                std::string_view key = opt.substr(0, eq);
+                std::string_view val = eq == std::string_view::npos ? std::string_view() : opt.substr(eq + 1);
+                bool ok = true;
+
+                if (key == "label")
+                {
+                    if (eq == std::string_view::npos) return fail(line_no, "expected label=<text>");
+
+                    // the label runs to the end of the line
+                    const char* start = opt.data() + eq + 1;
+                    r.label = std::string(trim(std::string_view(start, line.data() + line.size() - start)));
+                    break;
+                }
+                else if (key == "class")    ok = to_num(val, r.event_class) && r.event_class <= 3;
+                else if (key == "deadband") ok = to_num(val, r.deadband) && r.deadband >= 0.0;
+                else if (key == "scale")    ok = to_num(val, r.scale);
+                else if (key == "bias")     ok = to_num(val, r.bias);
+                else if (key == "rollup")   r.rollup = true;
+                else if (key == "svar")     ok = parse_variation(val, static_group(r.kind), r.static_var);
+                else if (key == "evar")     ok = parse_variation(val, event_group(r.kind), r.event_var);
+                else if (key == "event")
+                {
+                    ok = (val == "change" || val == "soe" || val == "every");
+                    r.every = (val == "every");
+                    r.soe = (val != "change");
+                }
+                else
+                {
+                    return fail(line_no, "unknown option '" + std::string(opt) + "'");
+                }
+
+                if (!ok) return fail(line_no, "bad value in '" + std::string(opt) + "'");
+            }
+
+            // what the gateway used before variations were configurable
+            if (!r.static_var) r.static_var = (r.kind == PointKind::Binary) ? 2 : 1;
+            if (!r.event_var)
+            {
+                r.event_var = (r.kind == PointKind::Analog) ? 7 : (r.kind == PointKind::Counter) ? 5 : 2;
+            }
+
+            if (r.label.empty()) r.label = r.type + " " + r.field;
+            routes.push_back(std::move(r));
+            route_line.push_back(line_no);
+        }
+        else
+        {
+            return fail(line_no, "unknown directive '" + std::string(word) + "'");
+        }
+    }
+
+    if (routes.empty()) return fail(line_no, "no points defined");
+
+    size_t binary = static_cast<size_t>(PointKind::Binary);
+    if (online >= stride[binary])
+        return fail(line_no, "online offset " + std::to_string(online) + " outside the binary block");
+
+    // compile: one entry per TYPE with its field keys, checked for clashes
+    std::vector<TypeEntry> types;
+    for (size_t i = 0; i < routes.size(); ++i)
+    {
+        PointRoute& r = routes[i];
+        size_t k = static_cast<size_t>(r.kind);
+
+        if (r.offset >= stride[k])
+        {
+            return fail(route_line[i], std::string(point_kind_name(r.kind)) + " offset " + std::to_string(r.offset) +
+                        " outside the " + std::to_string(stride[k]) + "-point block");
+        }
+        if (r.kind == PointKind::Binary && r.offset == online)
+            return fail(route_line[i], "binary offset " + std::to_string(r.offset) + " is the online point");
+
+        for (size_t j = 0; j < i; ++j)
+        {
+            if (routes[j].kind == r.kind && routes[j].offset == r.offset)
+            {
+                return fail(route_line[i], std::string(point_kind_name(r.kind)) + " offset " +
+                            std::to_string(r.offset) + " already used on line " + std::to_string(route_line[j]));
+            }
+        }
+
+        auto t = std::find_if(types.begin(), types.end(), [&](const TypeEntry& e) { return e.name == r.type; });
+        if (t == types.end())
+        {
+            if (types.size() == 255) return fail(route_line[i], "too many TYPEs");
+            types.emplace_back();
+            types.back().name = r.type;
+            for (char c : r.type) types.back().mqtt += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            t = types.end() - 1;
+        }
+        if (std::find(t->keys, t->keys + t->fields, r.field) != t->keys + t->fields)
+            return fail(route_line[i], r.type + " " + r.field + " mapped twice");
+        if (t->fields == MAPPED_FIELDS_MAX)
+            return fail(route_line[i], r.type + " has more than " + std::to_string(MAPPED_FIELDS_MAX) + " fields");
+
+        t->keys[t->fields] = r.field;
+        t->route[t->fields] = static_cast<uint16_t>(i);
+        ++t->fields;
+
+        r.type_id = static_cast<uint8_t>(t - types.begin());
+
+        // analogs first, then counters, then binaries: the original ids
+        // (TEMP 0 .. RIGHT 4, KEYPAD 5) stay valid in existing history files
+        uint16_t base = 0;
+        if (r.kind != PointKind::Analog) base += stride[static_cast<size_t>(PointKind::Analog)];
+        if (r.kind == PointKind::Binary) base += stride[static_cast<size_t>(PointKind::Counter)];
+        r.history_point = static_cast<uint16_t>(base + r.offset);
+    }
+
+    for (const MqttLine& m : mqtt)
+    {
+        auto t = std::find_if(types.begin(), types.end(), [&](const TypeEntry& e) { return e.name == m.type; });
+        if (t == types.end()) return fail(m.line, "mqtt name for " + m.type + ", which has no points");
+        if (m.control >= 0)
+        {
+            if (m.control > 0xFFFF) return fail(m.line, "control index " + std::to_string(m.control) + " too large");
+            for (const TypeEntry& other : types)
+            {
+                if (other.control == m.control)
+                    return fail(m.line, "control " + std::to_string(m.control) + " already used by " + other.name);
+            }
+        }
+        t->mqtt = m.name;
+        t->control = m.control;
+    }
+
+    std::copy(stride, stride + POINT_KINDS, stride_);
+    std::copy(events, events + POINT_KINDS, events_);
+    online_ = static_cast<uint16_t>(std::max(online, 0));
+    routes_ = std::move(routes);
+    types_ = std::move(types);
+    return true;
+}
+
+int PointMap::find_type(std::string_view name) const
+{
+    for (size_t i = 0; i < types_.size(); ++i)
+        if (types_[i].name == name) return static_cast<int>(i);
+    return -1;
+}
+
+int PointMap::find_control(uint16_t index) const
+{
+    for (size_t i = 0; i < types_.size(); ++i)
+        if (types_[i].control == index) return static_cast<int>(i);
+    return -1;
+}
+
+int PointMap::find_mqtt(std::string_view name) const
+{
+    for (size_t i = 0; i < types_.size(); ++i)
+        if (types_[i].mqtt == name) return static_cast<int>(i);
+    return -1;
+}
+
+bool PointMap::dispatch(const Frame& f, MappedFrame& out) const
+{
+    int t = find_type(f.type_name);
+    if (t < 0) return false;
+
+    const TypeEntry& e = types_[t];
+    out.type_id = static_cast<uint8_t>(t);
+    out.count = 0;
+
+    for (size_t i = 0; i < f.field_count; ++i)
+    {
+        for (size_t j = 0; j < e.fields; ++j)
+        {
+            if (e.keys[j] != f.fields[i].key) continue;
+
+            const PointRoute& r = routes_[e.route[j]];
+            out.values[out.count++] = { e.route[j], static_cast<float>(f.fields[i].value * r.scale + r.bias) };
+            break;
+        }
+    }
+    return true;
+}
+
+size_t PointMap::max_devices() const
+{
+    uint16_t widest = *std::max_element(stride_, stride_ + POINT_KINDS);
+    return 65536 / widest;
+}
+
+size_t PointMap::event_buffer(PointKind kind, size_t devices) const
+{
+    size_t per_device = events_[static_cast<size_t>(kind)];
+    if (!per_device)
+    {
+        size_t mapped = (kind == PointKind::Binary) ? 1 : 0;    // online
+        for (const PointRoute& r : routes_) mapped += (r.kind == kind);
+        per_device = 4 * mapped;
+    }
+    return std::min<size_t>(per_device * devices, 65535);
+}
+
+std::vector<std::string> PointMap::legend() const
+{
+    auto name = [&](PointKind kind, uint16_t offset) {
+        std::string s = point_kind_prefix(kind);
+        if (stride(kind) == 1) return s + "n";
+        return s + "(" + std::to_string(stride(kind)) + "n+" + std::to_string(offset) + ")";
+    };
+
+    std::vector<std::string> lines;
+    lines.push_back(name(PointKind::Binary, online_) + " = DEV n Online");
+
+    for (PointKind kind : { PointKind::Binary, PointKind::Analog, PointKind::Counter })
+    {
+        std::vector<const PointRoute*> block;
+        for (const PointRoute& r : routes_)
+            if (r.kind == kind) block.push_back(&r);
+        std::sort(block.begin(), block.end(),
+                  [](const PointRoute* a, const PointRoute* b) { return a->offset < b->offset; });
+
+        for (const PointRoute* r : block) lines.push_back(name(kind, r->offset) + " = " + r->label);
+    }
+
+    for (const TypeEntry& t : types_)
+    {
+        if (t.control >= 0)
+            lines.push_back("BO" + std::to_string(t.control) + " = " + t.mqtt + " enable (sensors/" + t.mqtt + "/0/cmd)");
+    }
+    return lines;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Frame;
+
+/* -------------------- POINT MAP --------------------
+ * Declarative mapping from frame fields to DNP3 points, read at startup
+ * from pointmap.conf (GATEWAY_POINT_MAP to use another file). Without a
+ * file the built-in default reproduces the original fixed layout:
+ *
+ *   block analog  5         every DEV n owns AI 5n..5n+4
+ *   block binary  1         ... BI n
+ *   block counter 1         ... CI n
+ *   online 0                BI n is the device's ONLINE status
+ *   events analog 16        outstation event buffer, per device
+ *   point ENV TEMP analog 0 class=2 deadband=0.25 svar=g30v5 rollup label=Temp
+ *   ...
+ *
+ * A point line names the TYPE and field key a value arrives in, the DNP3
+ * type and offset inside the device block, and options: class=0..3,
+ * deadband=, scale= and bias= (published value = field * scale + bias),
+ * event=change|soe|every, svar=/evar= (static and event variation, e.g.
+ * g30v5, checked against the point type) and rollup. label= takes the
+ * rest of the line. Without svar/evar a point keeps the variations the
+ * gateway always used (g30v1/g32v7, g1v2/g2v2, g20v1/g22v5).
+ * "mqtt <TYPE> <name> [control=<k>]" sets the name a TYPE uses in MQTT
+ * topics (sensors/dht/... for ENV; without it the TYPE is lower-cased)
+ * and the DNP3 binary output k that enables or disables it.
+ * TYPEs the parser has no built-in support for work too: any numeric
+ * KEY=VALUE field of a mapped TYPE is routed, so a new sensor only needs
+ * new lines here.
+ *
+ * load() compiles the lines into a flat dispatch table: per TYPE, the
+ * field keys and the route each feeds. dispatch() walks the fields of one
+ * parsed frame against it, with no per-type code in the gateway.
+ */
+
+enum class PointKind : uint8_t
+{
+    Binary,
+    Analog,
+    Counter
+};
+
+static constexpr size_t POINT_KINDS = 3;
+static constexpr size_t MAPPED_FIELDS_MAX = 8;   // fields per TYPE
+
+struct PointRoute
+{
+    std::string type;           // TYPE name in frames
+    std::string field;          // KEY in frames
+    std::string label;
+    PointKind kind = PointKind::Analog;
+    uint16_t offset = 0;        // inside the device block of `kind`
+    uint8_t type_id = 0;
+    uint8_t event_class = 1;    // 0 = static only
+    uint8_t static_var = 0;     // variation of static_group(kind)
+    uint8_t event_var = 0;      // variation of event_group(kind)
+    bool every = false;         // event on every frame, even if unchanged
+    bool soe = false;           // every change is its own event, in device order (set by every)
+    bool rollup = false;
+    double deadband = 0.0;
+    double scale = 1.0;
+    double bias = 0.0;
+    uint16_t history_point = 0; // per-device point id in the historian
+};
+
+struct MappedValue
+{
+    uint16_t route;             // index into PointMap::routes()
+    float value;                // already scaled
+};
+
+// The points one frame updates; safe to copy between threads
+struct MappedFrame
+{
+    uint8_t type_id = 0;
+    uint8_t count = 0;
+    MappedValue values[MAPPED_FIELDS_MAX];
+};
+
+class PointMap
+{
+public:
+    PointMap();     // built-in default layout
+
+    // Replaces the map with the file's contents; false (map unchanged) on
+    // a missing file or the first bad line, described in `error`.
+    bool load(const std::string& path, std::string& error);
+    bool parse(std::string_view text, const std::string& source, std::string& error);
+
+    // Fills `out` with every field of `f` the map routes; false when the
+    // TYPE is not in the map.
+    bool dispatch(const Frame& f, MappedFrame& out) const;
+    int find_type(std::string_view name) const;   // -1 when unknown
+
+    const PointRoute& route(size_t i) const { return routes_[i]; }
+    const std::vector<PointRoute>& routes() const { return routes_; }
+    const std::string& type_name(size_t type_id) const { return types_[type_id].name; }
+    size_t types() const { return types_.size(); }
+
+    // topic name of a TYPE, "sensors/<name>/<dev>/..." (lower-case TYPE by default)
+    const std::string& mqtt_name(size_t type_id) const { return types_[type_id].mqtt; }
+    int find_mqtt(std::string_view name) const;   // -1 when unknown
+
+    // DNP3 binary output that switches a TYPE on and off, -1 for none
+    int control(size_t type_id) const { return types_[type_id].control; }
+    int find_control(uint16_t index) const;       // TYPE id, -1 when unmapped
+
+    uint16_t stride(PointKind kind) const { return stride_[static_cast<size_t>(kind)]; }
+    uint16_t online_offset() const { return online_; }
+    size_t points(PointKind kind, size_t devices) const { return devices * stride(kind); }
+    size_t max_devices() const;     // largest device count whose indices fit 16 bits
+    size_t event_buffer(PointKind kind, size_t devices) const;   // outstation events kept, <= 65535
+
+    uint16_t index(size_t dev, const PointRoute& r) const
+    {
+        return static_cast<uint16_t>(dev * stride(r.kind) + r.offset);
+    }
+    uint16_t online_index(size_t dev) const
+    {
+        return static_cast<uint16_t>(dev * stride(PointKind::Binary) + online_);
+    }
+
+    // "AI(5n+0) = Temp" lines for the master
+    std::vector<std::string> legend() const;
+
+private:
+    struct TypeEntry
+    {
+        std::string name;
+        std::string mqtt;
+        int control = -1;
+        uint8_t fields = 0;
+        std::string keys[MAPPED_FIELDS_MAX];
+        uint16_t route[MAPPED_FIELDS_MAX];
+    };
+
+    uint16_t stride_[POINT_KINDS] = { 1, 5, 1 };
+    uint16_t events_[POINT_KINDS] = {};    // per device, 0 = 4 per mapped point
+    uint16_t online_ = 0;
+    std::vector<PointRoute> routes_;
+    std::vector<TypeEntry> types_;
+};
+
+const char* point_kind_name(PointKind kind);        // "analog"
+const char* point_kind_prefix(PointKind kind);      // "AI"
+uint8_t static_group(PointKind kind);               // 30 for analog
+uint8_t event_group(PointKind kind);                // 32 for analog
@@ -0,0 +1,118 @@
+#include "rollup.h"
+
+#include <algorithm>
+
+std::vector<RollupWindow> RollupEngine::default_windows()
+{
+    using namespace std::chrono;
+    return {
+        { duration_cast<milliseconds>(minutes(1)), 24 * 60 },
+        { duration_cast<milliseconds>(hours(1)),   24 * 7 },
+    };
+}
+
+RollupEngine::RollupEngine(size_t devices, std::vector<uint16_t> points,
+                           std::vector<RollupWindow> windows)
+    : windows_(std::move(windows)),
+      devices_(devices)
+{
+    slot_.fill(-1);
+    points_ = 0;
+    for (uint16_t p : points)
+    {
+        if (p < slot_.size() && slot_[p] < 0 && points_ < MAX_POINTS)
+            slot_[p] = static_cast<int8_t>(points_++);
+    }
+
+    series_.reset(new Series[devices_ * points_]);
+    for (size_t i = 0; i < devices_ * points_; ++i)
+    {
+        series_[i].rings.resize(windows_.size());
+        for (size_t w = 0; w < windows_.size(); ++w)
+            series_[i].rings[w].resize(std::max<size_t>(windows_[w].keep, 1));
+    }
+}
+
+bool RollupEngine::tracks(uint16_t point) const
+{
+    return point < slot_.size() && slot_[point] >= 0;
+}
+
+RollupEngine::Series* RollupEngine::find(uint16_t dev, uint16_t point) const
+{
+    if (dev >= devices_ || !tracks(point)) return nullptr;
+    return &series_[dev * points_ + slot_[point]];
+}
+
+void RollupEngine::add(uint16_t dev, uint16_t point, uint64_t time_ms, float value)
+{
+    Series* s = find(dev, point);
+    if (!s) return;
+
+    std::lock_guard<std::mutex> lock(s->mutex);
+    for (size_t w = 0; w < windows_.size(); ++w)
+    {
+        uint64_t width = windows_[w].width.count();
+        uint64_t bucket = time_ms / width;
+        std::vector<Rollup>& ring = s->rings[w];
+        Rollup& r = ring[bucket % ring.size()];
+        uint64_t start = bucket * width;
+
+        if (r.count == 0 || r.start_ms < start)
+        {
+            r = Rollup{};
+            r.start_ms = start;
+            r.min = r.max = value;
+        }
+        else if (r.start_ms > start)
+        {
+            continue;   // older than the ring keeps
+        }
+
+        r.min = std::min(r.min, value);
+        r.max = std::max(r.max, value);
+        r.last = value;
+        r.sum += value;
+        ++r.count;
+    }
+}
+
+std::vector<Rollup> RollupEngine::query(uint16_t dev, uint16_t point, size_t window,
+                                        uint64_t from_ms, uint64_t to_ms) const
+{
+    std::vector<Rollup> out;
+    Series* s = find(dev, point);
+    if (!s || window >= windows_.size()) return out;
+
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        for (const Rollup& r : s->rings[window])
+        {
+            if (r.count && r.start_ms >= from_ms && r.start_ms <= to_ms) out.push_back(r);
+        }
+    }
+
+    std::sort(out.begin(), out.end(),
+              [](const Rollup& a, const Rollup& b) { return a.start_ms < b.start_ms; });
+    return out;
+}
+
+Rollup RollupEngine::summary(uint16_t dev, uint16_t point, size_t window,
+                             uint64_t from_ms, uint64_t to_ms) const
+{
+    Rollup total;
+    for (const Rollup& r : query(dev, point, window, from_ms, to_ms))
+    {
+        if (total.count == 0)
+        {
+            total = r;
+            continue;
+        }
+        total.min = std::min(total.min, r.min);
+        total.max = std::max(total.max, r.max);
+        total.last = r.last;
+        total.sum += r.sum;
+        total.count += r.count;
+    }
+    return total;
+}
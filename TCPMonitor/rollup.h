@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* -------------------- ROLLUPS --------------------
+ * Min/max/mean/count/last per point for fixed time windows, updated as
+ * samples arrive so summary queries never scan raw history.
+ *
+ * Every (device, point) series keeps one ring of buckets per window size.
+ * A sample lands in bucket floor(time / width); the ring slot for that
+ * bucket is reset when a newer bucket reuses it, so each window keeps the
+ * last `keep` buckets (a day of minutes, a week of hours by default) and
+ * samples older than that are ignored.
+ *
+ * add() is called from the ingest thread; query() from anywhere. Each
+ * series has its own lock, held only for a few arithmetic updates.
+ */
+
+struct RollupWindow
+{
+    std::chrono::milliseconds width;
+    size_t keep;   // buckets kept in memory
+};
+
+struct Rollup
+{
+    uint64_t start_ms = 0;   // bucket start, multiple of the window width
+    uint32_t count = 0;
+    float min = 0.0f;
+    float max = 0.0f;
+    float last = 0.0f;
+    double sum = 0.0;
+
+    double mean() const { return count ? sum / count : 0.0; }
+};
+
+class RollupEngine
+{
+public:
+    static constexpr size_t MAX_POINTS = 8;
+
+    // 1 minute for a day, 1 hour for a week
+    static std::vector<RollupWindow> default_windows();
+
+    RollupEngine(size_t devices, std::vector<uint16_t> points,
+                 std::vector<RollupWindow> windows = default_windows());
+
+    bool tracks(uint16_t point) const;
+    void add(uint16_t dev, uint16_t point, uint64_t time_ms, float value);
+
+    // Buckets of window `window` whose start lies in [from_ms, to_ms],
+    // oldest first; the bucket still filling is included.
+    std::vector<Rollup> query(uint16_t dev, uint16_t point, size_t window,
+                              uint64_t from_ms, uint64_t to_ms) const;
+
+    // One bucket merging every bucket of `window` in [from_ms, to_ms].
+    Rollup summary(uint16_t dev, uint16_t point, size_t window,
+                   uint64_t from_ms, uint64_t to_ms) const;
+
+    const std::vector<RollupWindow>& windows() const { return windows_; }
+
+private:
+    struct Series
+    {
+        mutable std::mutex mutex;
+        std::vector<std::vector<Rollup>> rings;   // one per window
+    };
+
+    Series* find(uint16_t dev, uint16_t point) const;
+
+    std::vector<RollupWindow> windows_;
+    size_t devices_;
+    std::array<int8_t, 256> slot_;                // point id -> series slot, -1 = not tracked
+    size_t points_;
+    std::unique_ptr<Series[]> series_;            // devices_ * points_
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "device_table.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/* -------------------- SEQUENCE TRACKER --------------------
+ * Per-device gap and duplicate detection for frames that carry a sequence
+ * number (binary frames, or SEQ= on ASCII frames).
+ *
+ * Each device keeps the highest sequence seen and a 64-entry bitmap of
+ * the ones just below it, like an IPsec replay window:
+ *   - newer than the highest: accepted, any skipped numbers count as lost
+ *   - inside the window and not seen yet: accepted late, lost goes back down
+ *   - already seen: duplicate, rejected
+ *   - far older than the window: a device restart, unless its device time
+ *     is older than the last frame accepted, which makes it a replay of
+ *     frames already applied (the firmware's store and forward queue
+ *     resends after a reconnect or reboot): rejected as a duplicate
+ * A device that restarts less than WINDOW frames into its sequence is
+ * reported as duplicates until it passes its old highest number. Frames
+ * without a device time (TS=, 0 when the device had no clock) are judged
+ * by the sequence number alone.
+ *
+ * observe() runs only on the ingest worker that owns the device (every
+ * device has exactly one); the counters are atomics so
+ * the stats loop can read them at any time.
+ */
+
+struct SeqCounters
+{
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> lost{0};         // gaps not (yet) filled by late frames
+    std::atomic<uint64_t> duplicates{0};
+    std::atomic<uint64_t> reordered{0};    // accepted late, inside the window
+    std::atomic<uint64_t> restarts{0};
+};
+
+class SeqTracker
+{
+public:
+    static constexpr uint32_t WINDOW = 64;
+
+    // true when the frame should be applied, false for a duplicate
+    bool observe(size_t dev, uint32_t seq, uint64_t time_ms = 0)
+    {
+        if (dev >= MAX_DEVICES) return true;
+        State& s = state_[dev];
+        SeqCounters& c = counters_[dev];
+
+        if (!s.started)
+        {
+            s.started = true;
+            s.highest = seq;
+            s.seen = 1;
+            s.time_ms = time_ms;
+            bump(c.received);
+            return true;
+        }
+
+        int32_t diff = static_cast<int32_t>(seq - s.highest);
+
+        if (diff > 0)
+        {
+            uint32_t gap = static_cast<uint32_t>(diff) - 1;
+            s.seen = (static_cast<uint32_t>(diff) >= WINDOW) ? 0 : (s.seen << diff);
+            s.seen |= 1;
+            s.highest = seq;
+            if (time_ms) s.time_ms = time_ms;
+            if (gap) c.lost.fetch_add(gap, std::memory_order_relaxed);
+            bump(c.received);
+            return true;
+        }
+
+        uint32_t back = static_cast<uint32_t>(-static_cast<int64_t>(diff));
+        if (back >= WINDOW)
+        {
+            if (time_ms && time_ms < s.time_ms)
+            {
+                // far behind and older too: a stale replay
+                bump(c.duplicates);
+                return false;
+            }
+
+            // far behind: the device rebooted and started counting again
+            s.highest = seq;
+            s.seen = 1;
+            s.time_ms = time_ms;
+            bump(c.restarts);
+            bump(c.received);
+            return true;
+        }
+
+        uint64_t bit = uint64_t(1) << back;
+        if (s.seen & bit)
+        {
+            bump(c.duplicates);
+            return false;
+        }
+
+        s.seen |= bit;
+        if (c.lost.load(std::memory_order_relaxed) > 0)
+            c.lost.fetch_sub(1, std::memory_order_relaxed);
+        bump(c.reordered);
+        bump(c.received);
+        return true;
+    }
+
+    const SeqCounters& counters(size_t dev) const { return counters_[dev]; }
+
+private:
+    struct State
+    {
+        bool started = false;
+        uint32_t highest = 0;
+        uint64_t seen = 0;     // bit n = highest - n received
+        uint64_t time_ms = 0;  // device time of the highest, 0 = none
+    };
+
+    static void bump(std::atomic<uint64_t>& v) { v.fetch_add(1, std::memory_order_relaxed); }
+
+    State state_[MAX_DEVICES];
+    SeqCounters counters_[MAX_DEVICES];
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "frame_parser.h"
+#include "point_map.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/* -------------------- SHARD QUEUE --------------------
+ * With several ingest workers every device is owned by one of them
+ * (dev % workers), so the device table, sequence tracker and DNP3 batch
+ * of that device keep a single writer. A worker that receives a frame
+ * for a device it does not own parses and maps it, then hands the Frame
+ * and its mapped values over through the owner's ShardQueue.
+ *
+ * Bounded MPSC ring, the same sequence-per-cell design as AsyncLog: any
+ * worker may push, only the owner pops. push() fails on a full ring; the
+ * sender then wakes the owner and drains its own inbox while it retries,
+ * so two workers waiting on each other always make progress and a slow
+ * owner slows its senders (TCP backpressure) instead of losing frames.
+ *
+ * Frame::type_name and Frame::fields must not point into a receive buffer
+ * when pushed; the owner only needs the MappedFrame.
+ */
+
+struct ShardFrame
+{
+    Frame frame;
+    MappedFrame mapped;
+    std::chrono::steady_clock::time_point received;
+    std::chrono::steady_clock::time_point parsed;
+};
+
+class ShardQueue
+{
+public:
+    explicit ShardQueue(size_t capacity = 4096)   // rounded up to a power of two
+    {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+
+        cells_.reset(new Cell[n]);
+        mask_ = n - 1;
+        for (size_t i = 0; i < n; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ShardQueue(const ShardQueue&) = delete;
+    ShardQueue& operator=(const ShardQueue&) = delete;
+
+    bool push(const ShardFrame& f)
+    {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* c;
+
+        for (;;)
+        {
+            c = &cells_[pos & mask_];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (diff == 0)
+            {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;   // full: the owner has not reached this cell yet
+            }
+            else
+            {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+
+        c->item = f;
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // owner only
+    bool pop(ShardFrame& f)
+    {
+        Cell& c = cells_[tail_ & mask_];
+        if (c.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+
+        f = c.item;
+        c.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+
+private:
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> seq;
+        ShardFrame item;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_{0};   // producers
+    alignas(64) size_t tail_ = 0;               // owner only
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "point_map.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/* -------------------- SOE RING --------------------
+ * Per-device sequence-of-events buffer for points mapped event=soe or
+ * event=every (motion, rotary, keypad): every edge is kept as its own
+ * entry with the device's timestamp until the publisher applies it.
+ *
+ * Entries stay sorted by device time, then by sequence number, so a frame
+ * that arrives late (UDP reordering inside the SeqTracker window) is
+ * slotted in before the edges it preceded on the device. Frames with
+ * equal time and no sequence keep their arrival order.
+ *
+ * The ring never overwrites: push() returns false when it is full and the
+ * caller applies (drains) the pending batch first, so a burst of edges
+ * costs an early Apply(), never an edge.
+ *
+ * Owned by one Dnp3Publisher, so only its ingest thread touches it.
+ */
+
+struct SoeEntry
+{
+    uint64_t time_ms;
+    uint32_t seq;
+    bool has_seq;
+    PointKind kind;
+    uint16_t index;
+    double value;
+    std::chrono::steady_clock::time_point committed;   // for the commit->apply trace
+};
+
+class SoeRing
+{
+public:
+    static constexpr size_t CAPACITY = 32;
+
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == CAPACITY; }
+    size_t size() const { return count_; }
+
+    // false when full; `reordered` is set when the entry went before others
+    bool push(const SoeEntry& e, bool& reordered)
+    {
+        if (full()) return false;
+
+        size_t pos = count_;
+        while (pos > 0 && before(e, at(pos - 1)))
+        {
+            at(pos) = at(pos - 1);
+            --pos;
+        }
+        at(pos) = e;
+        reordered = (pos != count_);
+        ++count_;
+        return true;
+    }
+
+    // oldest first
+    template <class Fn>
+    void drain(Fn&& fn)
+    {
+        for (size_t i = 0; i < count_; ++i) fn(at(i));
+        head_ = (head_ + count_) % CAPACITY;
+        count_ = 0;
+    }
+
+private:
+    static bool before(const SoeEntry& a, const SoeEntry& b)
+    {
+        if (a.time_ms != b.time_ms) return a.time_ms < b.time_ms;
+        return a.has_seq && b.has_seq && static_cast<int32_t>(a.seq - b.seq) < 0;
+    }
+
+    SoeEntry& at(size_t i) { return entries_[(head_ + i) % CAPACITY]; }
+
+    SoeEntry entries_[CAPACITY];
+    size_t head_ = 0;
+    size_t count_ = 0;
+};